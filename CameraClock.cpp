@@ -0,0 +1,198 @@
+#include "stdafx.h"
+
+#include "CameraClock.h"
+
+#include <iostream>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	// Below this the slope is not estimated, the fit is a mean offset
+	static const unsigned int kMinSamples = 30;
+	// An arrival this far from the prediction is a jump of one of the clocks
+	static const double kJump = 0.5;
+	// Late arrivals rejected in a row before the fit restarts
+	static const unsigned int kMaxOutliers = 30;
+	// Real clocks are within a few hundred ppm, a larger slope comes from too short a span
+	static const double kMaxDrift = 1e-3;
+
+	static double secondsBetween(const OSVR_TimeValue& from, const OSVR_TimeValue& to) {
+		return static_cast<double>(to.seconds - from.seconds) + (to.microseconds - from.microseconds) / 1e6;
+	}
+
+	static OSVR_TimeValue addSeconds(const OSVR_TimeValue& time, double seconds) {
+		int64_t microseconds = static_cast<int64_t>(time.seconds) * 1000000 + time.microseconds + static_cast<int64_t>(floor(seconds * 1e6 + 0.5));
+		OSVR_TimeValue result;
+		result.seconds = microseconds / 1000000;
+		result.microseconds = static_cast<int32_t>(microseconds % 1000000);
+		if (result.microseconds < 0) {
+			result.seconds -= 1;
+			result.microseconds += 1000000;
+		}
+		return result;
+	}
+
+	CameraClock::CameraClock(const Json::Value& config) {
+		m_exposureDelay = config.get("exposureDelay", 0.0).asDouble() / 1000.0;
+		m_window = config.get("window", 30.0).asDouble();
+
+		m_originCapture = 0;
+		m_originArrival.seconds = 0;
+		m_originArrival.microseconds = 0;
+		m_w = 0;
+		m_sx = 0;
+		m_sy = 0;
+		m_sxx = 0;
+		m_sxy = 0;
+		m_syy = 0;
+		m_slope = 1;
+		m_intercept = 0;
+		m_residual = 0;
+		m_samples = 0;
+		m_outliers = 0;
+		m_span = 0;
+		m_reported = false;
+
+		m_stats.frames = 0;
+		m_stats.sourceClock = false;
+		m_stats.offset = 0;
+		m_stats.driftPpm = 0;
+		m_stats.residualMs = 0;
+		m_stats.resets = 0;
+	}
+
+	bool CameraClock::validate(const Json::Value& config, std::string* error) {
+		if (!config.isObject()) {
+			*error = "\"cameraClock\" must be an object";
+			return false;
+		}
+		const Json::Value& exposureDelay = config["exposureDelay"];
+		if (!exposureDelay.isNull() && (!exposureDelay.isNumeric() || exposureDelay.asDouble() < 0 || exposureDelay.asDouble() > 500)) {
+			*error = "\"cameraClock.exposureDelay\" must be in [0, 500] (ms)";
+			return false;
+		}
+		const Json::Value& window = config["window"];
+		if (!window.isNull() && (!window.isNumeric() || window.asDouble() < 1 || window.asDouble() > 3600)) {
+			*error = "\"cameraClock.window\" must be in [1, 3600] (s)";
+			return false;
+		}
+		return true;
+	}
+
+	OSVR_TimeValue CameraClock::map(const FrameTime& frame) {
+		m_stats.frames++;
+
+		if (frame.captureTimeUs == 0) {
+			m_stats.sourceClock = false;
+			return addSeconds(frame.arrivalTime, -m_exposureDelay);
+		}
+		m_stats.sourceClock = true;
+
+		if (m_samples == 0) {
+			restart(frame);
+			return addSeconds(frame.arrivalTime, -m_exposureDelay);
+		}
+
+		double x = (static_cast<double>(frame.captureTimeUs) - static_cast<double>(m_originCapture)) / 1e6;
+		double y = secondsBetween(m_originArrival, frame.arrivalTime);
+		double error = y - predictArrival(x);
+
+		// Source restarted or wrapped, or a clock was set
+		if (frame.captureTimeUs <= m_originCapture || (m_samples >= kMinSamples && fabs(error) > kJump)) {
+			std::cout << "[TrackerKudan-OSVR] Camera clock jumped by " << error << " s, estimate restarted" << std::endl;
+			m_stats.resets++;
+			restart(frame);
+			return addSeconds(frame.arrivalTime, -m_exposureDelay);
+		}
+
+		// A frame stuck somewhere on its way in would bias the fit, it is mapped without being added
+		double gate = 5 * m_residual > 0.002 ? 5 * m_residual : 0.002;
+		if (m_samples >= kMinSamples && error > gate && ++m_outliers < kMaxOutliers) {
+			return addSeconds(m_originArrival, predictArrival(x) - m_exposureDelay);
+		}
+		if (m_outliers >= kMaxOutliers) {
+			std::cout << "[TrackerKudan-OSVR] Camera frames arrive later than the clock estimate, estimate restarted" << std::endl;
+			m_stats.resets++;
+			restart(frame);
+			return addSeconds(frame.arrivalTime, -m_exposureDelay);
+		}
+		m_outliers = 0;
+
+		// Move the origin to the new sample, so that the sums stay small whatever the clocks say
+		m_sxx += -2 * x * m_sx + x * x * m_w;
+		m_sxy += -x * m_sy - y * m_sx + x * y * m_w;
+		m_syy += -2 * y * m_sy + y * y * m_w;
+		m_sx -= x * m_w;
+		m_sy -= y * m_w;
+		m_originCapture = frame.captureTimeUs;
+		m_originArrival = frame.arrivalTime;
+
+		// Exponential forgetting over the window, then the new sample at the origin
+		double decay = exp(-x / m_window);
+		m_w = m_w * decay + 1;
+		m_sx *= decay;
+		m_sy *= decay;
+		m_sxx *= decay;
+		m_sxy *= decay;
+		m_syy *= decay;
+		m_samples++;
+		m_span += x;
+
+		double meanX = m_sx / m_w;
+		double meanY = m_sy / m_w;
+		double varX = m_sxx / m_w - meanX * meanX;
+		double covXY = m_sxy / m_w - meanX * meanY;
+		double varY = m_syy / m_w - meanY * meanY;
+
+		m_slope = 1;
+		if (m_samples >= kMinSamples && varX > 0) {
+			double slope = covXY / varX;
+			if (fabs(slope - 1) < kMaxDrift) {
+				m_slope = slope;
+			}
+		}
+		m_intercept = meanY - m_slope * meanX;
+		double meanSquare = varY - 2 * m_slope * covXY + m_slope * m_slope * varX;
+		m_residual = meanSquare > 0 ? sqrt(meanSquare) : 0;
+
+		updateStats();
+		// Reported once the fit spans a whole window, earlier the drift is mostly noise
+		if (!m_reported && m_span >= m_window) {
+			std::cout << "[TrackerKudan-OSVR] Camera clock: drift " << m_stats.driftPpm << " ppm, residual " << m_stats.residualMs << " ms" << std::endl;
+			m_reported = true;
+		}
+
+		return addSeconds(m_originArrival, m_intercept - m_exposureDelay);
+	}
+
+	void CameraClock::restart(const FrameTime& frame) {
+		m_originCapture = frame.captureTimeUs;
+		m_originArrival = frame.arrivalTime;
+		m_w = 1;
+		m_sx = 0;
+		m_sy = 0;
+		m_sxx = 0;
+		m_sxy = 0;
+		m_syy = 0;
+		m_slope = 1;
+		m_intercept = 0;
+		m_residual = 0;
+		m_samples = 1;
+		m_outliers = 0;
+		m_span = 0;
+		m_reported = false;
+		updateStats();
+	}
+
+	double CameraClock::predictArrival(double x) const {
+		return m_intercept + m_slope * x;
+	}
+
+	void CameraClock::updateStats() {
+		double arrival = static_cast<double>(m_originArrival.seconds) + m_originArrival.microseconds / 1e6;
+		m_stats.offset = arrival + m_intercept - static_cast<double>(m_originCapture) / 1e6;
+		// The fit gives OSVR seconds per source second, a fast source clock has a slope below one
+		m_stats.driftPpm = (1 / m_slope - 1) * 1e6;
+		m_stats.residualMs = m_residual * 1000;
+	}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "stdafx.h"
+
+#include <cstdint>
+#include <string>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Times of the frame a tracker update processed.
+	struct FrameTime {
+		bool valid;					// false when the update had no new frame
+		uint64_t captureTimeUs;		// source clock, 0 if the source has none
+		OSVR_TimeValue arrivalTime;	// OSVR clock, when the frame reached the host
+	};
+
+	struct CameraClockStats {
+		uint64_t frames;
+		bool sourceClock;	// false while frames come without source timestamps
+		double offset;		// s, OSVR time minus source time at the last frame
+		double driftPpm;	// rate of the source clock relative to the OSVR clock
+		double residualMs;	// RMS of the arrival times around the fit
+		uint32_t resets;	// source clock jumps, each restarts the fit
+	};
+
+	/// Maps frame capture times to the OSVR clock.
+	/// With source timestamps, a running linear regression of the arrival times against the capture
+	/// times follows the offset and drift between the two clocks, forgetting samples older than about
+	/// "window" seconds. The fit averages out the arrival jitter (USB, polling by the update loop).
+	/// Without, the arrival time is used as is. Either way the result is a mean arrival time, so
+	/// "exposureDelay" is the mean latency from the middle of the exposure to the arrival on the host,
+	/// transport and polling included, and is taken off.
+	class CameraClock {
+	public:
+		/// config is the "cameraClock" device param: { "exposureDelay" (ms), "window" (s) }. Measure
+		/// exposureDelay by filming a screen that shows the OSVR time: the mean of the arrival times minus
+		/// the shown times, less the display latency.
+		explicit CameraClock(const Json::Value& config);
+		/// Checks the "cameraClock" device param, absent values keep their defaults.
+		static bool validate(const Json::Value& config, std::string* error);
+
+		/// Capture time of the frame on the OSVR clock. Frames must come in capture order.
+		OSVR_TimeValue map(const FrameTime& frame);
+
+		CameraClockStats getStats() const { return m_stats; }
+
+	private:
+		void restart(const FrameTime& frame);
+		/// Arrival time the fit predicts for the current origin, relative to it (s).
+		double predictArrival(double x) const;
+		void updateStats();
+
+		double m_exposureDelay;	// s
+		double m_window;		// s
+
+		// Sums over the weighted samples, relative to the last sample (the origin), in seconds
+		uint64_t m_originCapture;
+		OSVR_TimeValue m_originArrival;
+		double m_w;
+		double m_sx;
+		double m_sy;
+		double m_sxx;
+		double m_sxy;
+		double m_syy;
+
+		double m_slope;
+		double m_intercept;
+		double m_residual;
+		unsigned int m_samples;		// since the last restart
+		unsigned int m_outliers;	// in a row
+		double m_span;				// s of source clock since the last restart
+		bool m_reported;
+
+		CameraClockStats m_stats;
+	};
+
+}
@@ -0,0 +1,210 @@
+// Checks CameraClock against simulated cameras: a source clock with offset and skew, arrival
+// jitter, dropped and late frames, a source restart and a skew that changes while running.
+// Compares the capture times it gives with the arrival times a tracker would use otherwise.
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CameraClock.h"
+
+using namespace com_samaust_trackerkudan_osvr;
+
+static const double kWindow = 30;
+
+static void usage() {
+	std::cout << "Usage: trackerkudan_clock_sim [options]" << std::endl
+		<< "  --seconds <s>       simulated time per scenario (default 300)" << std::endl
+		<< "  --fps <fps>         frame rate (default 60)" << std::endl
+		<< "  --tick <ms>         update loop period the frames are polled at (default 4)" << std::endl
+		<< "  --seed <n>          random seed (default 1)" << std::endl;
+}
+
+struct Scenario {
+	const char* name;
+	double skewPpm;			// source clock rate error at the start
+	double skewRate;		// ppm/s, warming up
+	double dropRate;		// frames never delivered
+	double lateRate;		// frames held back by the host
+	double restartAt;		// s, the source clock restarts from zero, 0 for never
+};
+
+struct Options {
+	double seconds;
+	double fps;
+	double tick;
+	unsigned int seed;
+};
+
+struct Errors {
+	double bias;
+	double deviation;
+	double p99;
+};
+
+// Error of stamped times against the true capture times, the constant part apart
+static Errors summarize(std::vector<double> errors) {
+	Errors result;
+	double sum = 0;
+	for (size_t i = 0; i < errors.size(); i++) {
+		sum += errors[i];
+	}
+	result.bias = sum / errors.size();
+
+	double squares = 0;
+	for (size_t i = 0; i < errors.size(); i++) {
+		errors[i] = fabs(errors[i] - result.bias);
+		squares += errors[i] * errors[i];
+	}
+	result.deviation = sqrt(squares / errors.size());
+	std::sort(errors.begin(), errors.end());
+	result.p99 = errors[static_cast<size_t>(errors.size() * 0.99)];
+	return result;
+}
+
+static OSVR_TimeValue toTimeValue(double seconds) {
+	OSVR_TimeValue time;
+	time.seconds = static_cast<int64_t>(floor(seconds));
+	time.microseconds = static_cast<int32_t>((seconds - floor(seconds)) * 1e6);
+	return time;
+}
+
+static double toSeconds(const OSVR_TimeValue& time) {
+	return time.seconds + time.microseconds / 1e6;
+}
+
+static bool run(const Scenario& scenario, const Options& options) {
+	std::mt19937 random(options.seed);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	std::exponential_distribution<double> usbJitter(1 / 0.0015);
+
+	// OSVR clock is wall time, the source clock started with the camera
+	const double osvrStart = 1.7e9;
+	const double sourceStart = 12345.678;
+	const double transport = 0.008;	// fixed part of exposure to arrival
+	// Mean exposure to arrival latency, what "exposureDelay" stands for: transport, mean USB jitter, mean wait for the tick
+	const double exposureDelay = transport + 0.0015 + options.tick / 2000;
+
+	Json::Value config;
+	config["exposureDelay"] = exposureDelay * 1000;
+	config["window"] = kWindow;
+	CameraClock clock(config);
+
+	std::vector<double> mapped;
+	std::vector<double> arrival;
+	double sourceTime = sourceStart;
+	double lastTime = 0;
+	bool restarted = false;
+
+	int frames = static_cast<int>(options.seconds * options.fps);
+	for (int i = 0; i < frames; i++) {
+		double t = i / options.fps;
+		double skew = (scenario.skewPpm + scenario.skewRate * t) * 1e-6;
+		sourceTime += (t - lastTime) * (1 + skew);
+		lastTime = t;
+		if (scenario.restartAt > 0 && !restarted && t >= scenario.restartAt) {
+			sourceTime = 0.5;
+			restarted = true;
+		}
+
+		if (uniform(random) < scenario.dropRate) {
+			continue;
+		}
+
+		// Transfer, USB jitter, then the update loop polling at its own pace
+		double arrived = t + transport + usbJitter(random);
+		if (uniform(random) < scenario.lateRate) {
+			arrived += 0.02 + 0.05 * uniform(random);
+		}
+		arrived = ceil(arrived / (options.tick / 1000) + uniform(random) * 0.1) * (options.tick / 1000);
+
+		FrameTime frame;
+		frame.valid = true;
+		frame.captureTimeUs = static_cast<uint64_t>(sourceTime * 1e6);
+		frame.arrivalTime = toTimeValue(osvrStart + arrived);
+		double stamped = toSeconds(clock.map(frame)) - osvrStart;
+
+		// Leave the settling time of each fit out
+		bool settling = t < 10 || (restarted && t < scenario.restartAt + 10);
+		if (!settling) {
+			mapped.push_back(stamped - t);
+			arrival.push_back(arrived - exposureDelay - t);
+		}
+	}
+
+	Errors clockErrors = summarize(mapped);
+	Errors arrivalErrors = summarize(arrival);
+	CameraClockStats stats = clock.getStats();
+
+	// The weighted fit follows a changing skew about two windows late
+	double lagged = options.seconds > 2 * kWindow ? options.seconds - 2 * kWindow : 0;
+	double expectedPpm = scenario.skewPpm + scenario.skewRate * lagged;
+	double driftError = stats.driftPpm - expectedPpm;
+	bool passed = fabs(driftError) < 10 && clockErrors.p99 < arrivalErrors.p99 / 2 && fabs(clockErrors.bias) < 0.002
+		&& stats.resets == (scenario.restartAt > 0 ? 1u : 0u);
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< std::left << std::setw(14) << scenario.name << std::right
+		<< std::setw(9) << expectedPpm << std::setw(9) << stats.driftPpm
+		<< std::setw(9) << stats.residualMs
+		<< std::setw(9) << clockErrors.bias * 1000 << std::setw(9) << clockErrors.deviation * 1000 << std::setw(9) << clockErrors.p99 * 1000
+		<< std::setw(9) << arrivalErrors.deviation * 1000 << std::setw(9) << arrivalErrors.p99 * 1000
+		<< std::setw(7) << stats.resets << "  " << (passed ? "ok" : "FAILED") << std::endl;
+	return passed;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	options.seconds = 300;
+	options.fps = 60;
+	options.tick = 4;
+	options.seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--seconds" && i + 1 < argc) {
+			options.seconds = atof(argv[++i]);
+		}
+		else if (arg == "--fps" && i + 1 < argc) {
+			options.fps = atof(argv[++i]);
+		}
+		else if (arg == "--tick" && i + 1 < argc) {
+			options.tick = atof(argv[++i]);
+		}
+		else if (arg == "--seed" && i + 1 < argc) {
+			options.seed = static_cast<unsigned int>(atoi(argv[++i]));
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	const Scenario scenarios[] = {
+		{ "ideal", 0, 0, 0, 0, 0 },
+		{ "skew", 80, 0, 0, 0, 0 },
+		{ "negative skew", -150, 0, 0, 0, 0 },
+		{ "drops", 80, 0, 0.1, 0, 0 },
+		{ "late frames", 80, 0, 0, 0.05, 0 },
+		{ "restart", 80, 0, 0, 0, options.seconds / 2 },
+		{ "warming up", 20, 0.2, 0, 0, 0 }
+	};
+
+	std::cout << "Errors of the capture times in ms, apart from their bias, against arrival times minus the delay" << std::endl;
+	std::cout << std::left << std::setw(14) << "scenario" << std::right
+		<< std::setw(9) << "ppm" << std::setw(9) << "est ppm" << std::setw(9) << "resid"
+		<< std::setw(9) << "bias" << std::setw(9) << "rms" << std::setw(9) << "p99"
+		<< std::setw(9) << "arr rms" << std::setw(9) << "arr p99" << std::setw(7) << "resets" << std::endl;
+
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		passed = run(scenarios[i], options) && passed;
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+#include "stdafx.h"
+#include <iostream>
+
+#include "FrameSource.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	IFrameSource* FrameSourceFactory::getSource(Json::Value config) {
+		IFrameSource* source = NULL;
+
+		int cameraType = config["cameraType"].asInt();
+		if (cameraType == 1) {
+			source = new VideoCaptureFrameSource(config["cameraIndex"].asInt(), getThreadPlacement(config, "capture"));
+		}
+		if (cameraType == 2) {
+			source = new SharedMemoryFrameSource(config.get("sharedMemoryName", "TrackerKudanFrames").asString());
+		}
+		if (cameraType == 3) {
+			source = new SessionFrameSource(config["replaySession"].asString());
+		}
+
+		return source;
+	}
+
+	VideoCaptureFrameSource::VideoCaptureFrameSource(int cameraIndex, ThreadPlacement capturePlacement) : m_running(false) {
+		m_cameraIndex = cameraIndex;
+		m_capturePlacement = capturePlacement;
+		m_hasNewFrame = false;
+	}
+	VideoCaptureFrameSource::~VideoCaptureFrameSource() {
+		m_running = false;
+		if (m_captureThread.joinable()) {
+			m_captureThread.join();
+		}
+	}
+	bool VideoCaptureFrameSource::open() {
+		m_videoCapture.open(m_cameraIndex);
+		if (!m_videoCapture.isOpened()) {
+			std::cout << "[TrackerKudan-OSVR] Failed to open video capture" << std::endl;
+			return false;
+		}
+		m_running = true;
+		m_captureThread = std::thread(&VideoCaptureFrameSource::captureLoop, this);
+		return true;
+	}
+	void VideoCaptureFrameSource::captureLoop() {
+		applyThreadPlacement(m_capturePlacement);
+
+		cv::Mat grabbed;
+		while (m_running) {
+			if (!m_videoCapture.read(grabbed) || grabbed.empty()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				continue;
+			}
+			// Stamped here rather than when the tracker takes the frame, which may be a tick later
+			OSVR_TimeValue arrivalTime;
+			osvrTimeValueGetNow(&arrivalTime);
+
+			// Buffers rotate between the three Mats, the one lent to the tracker is never written here
+			std::lock_guard<std::mutex> lock(m_mutex);
+			cv::swap(m_captured, grabbed);
+			m_capturedTime = arrivalTime;
+			m_hasNewFrame = true;
+		}
+	}
+	bool VideoCaptureFrameSource::acquireFrame(FrameView* frame) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_hasNewFrame) {
+				return false;
+			}
+			cv::swap(m_frame, m_captured);
+			m_frameTime = m_capturedTime;
+			m_hasNewFrame = false;
+		}
+
+		frame->data = m_frame.data;
+		frame->width = m_frame.cols;
+		frame->height = m_frame.rows;
+		frame->channels = m_frame.channels();
+		frame->stride = static_cast<int>(m_frame.step);
+		// Webcam drivers rarely give a usable capture time, CameraClock goes by the arrival
+		frame->captureTimeUs = 0;
+		frame->arrivalTime = m_frameTime;
+		frame->depth = NULL;
+		frame->depthStride = 0;
+		return true;
+	}
+	void VideoCaptureFrameSource::releaseFrame() {
+	}
+
+	SharedMemoryFrameSource::SharedMemoryFrameSource(std::string name) {
+		m_name = name;
+		m_reportedBadFrame = false;
+	}
+	bool SharedMemoryFrameSource::open() {
+		m_lastOpenAttempt = std::chrono::steady_clock::now();
+		m_lastFrame = m_lastOpenAttempt;
+		if (!m_ring.open(m_name)) {
+			std::cout << "[TrackerKudan-OSVR] Waiting for a producer on shared memory " << m_name << std::endl;
+			return false;
+		}
+		std::cout << "[TrackerKudan-OSVR] Attached to shared memory " << m_name << std::endl;
+		return true;
+	}
+	bool SharedMemoryFrameSource::acquireFrame(FrameView* frame) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+		// The producer may start after us, or restart and recreate the mapping: reattach once a second while starved
+		if (now - m_lastFrame > std::chrono::seconds(1) && now - m_lastOpenAttempt > std::chrono::seconds(1)) {
+			m_lastOpenAttempt = now;
+			m_ring.open(m_name);
+		}
+		if (!m_ring.isOpen()) {
+			return false;
+		}
+
+		const SharedFrameHeader* header;
+		const unsigned char* data = m_ring.acquireLatest(&header);
+		if (data == NULL) {
+			return false;
+		}
+
+		// The header comes from another process, a frame that does not fit its slot is dropped
+		int channels = 0;
+		if (header->format == SHARED_FRAME_GREY8) {
+			channels = 1;
+		}
+		else if (header->format == SHARED_FRAME_BGR24) {
+			channels = 3;
+		}
+		if (channels == 0 || header->width == 0 || header->height == 0
+			|| static_cast<uint64_t>(header->stride) < static_cast<uint64_t>(header->width) * channels
+			|| static_cast<uint64_t>(header->stride) * header->height > m_ring.maxFrameBytes()) {
+			if (!m_reportedBadFrame) {
+				std::cout << "[TrackerKudan-OSVR] Ignoring shared memory frames with format " << header->format << ", size "
+					<< header->width << " x " << header->height << " and stride " << header->stride << std::endl;
+				m_reportedBadFrame = true;
+			}
+			m_ring.release();
+			return false;
+		}
+
+		frame->data = data;
+		frame->width = header->width;
+		frame->height = header->height;
+		frame->channels = channels;
+		frame->stride = header->stride;
+		frame->captureTimeUs = header->timestampUs;
+		osvrTimeValueGetNow(&frame->arrivalTime);
+		frame->depth = NULL;
+		frame->depthStride = 0;
+		m_lastFrame = now;
+		return true;
+	}
+	void SharedMemoryFrameSource::releaseFrame() {
+		m_ring.release();
+	}
+
+	SessionFrameSource::SessionFrameSource(std::string path) {
+		m_path = path;
+		m_hasRecord = false;
+		m_started = false;
+		m_firstHostTimeUs = 0;
+	}
+	bool SessionFrameSource::open() {
+		if (!m_reader.open(m_path)) {
+			return false;
+		}
+		std::cout << "[TrackerKudan-OSVR] Replaying session " << m_path << std::endl;
+		return true;
+	}
+	bool SessionFrameSource::acquireFrame(FrameView* frame) {
+		if (!m_hasRecord) {
+			if (!m_reader.next(&m_record)) {
+				// Next pass, paced from its own first frame
+				m_reader.rewind();
+				m_started = false;
+				if (!m_reader.next(&m_record)) {
+					return false;
+				}
+			}
+			m_hasRecord = true;
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (!m_started) {
+			m_replayStart = now;
+			m_firstHostTimeUs = m_record.header.hostTimeUs;
+			m_started = true;
+		}
+		// Paced by the recorded arrivals, the capture clock of the camera may have jumped
+		int64_t dueUs = static_cast<int64_t>(m_record.header.hostTimeUs - m_firstHostTimeUs);
+		if (std::chrono::duration_cast<std::chrono::microseconds>(now - m_replayStart).count() < dueUs) {
+			return false;
+		}
+
+		frame->data = m_record.frame.data();
+		frame->width = m_record.header.width;
+		frame->height = m_record.header.height;
+		frame->channels = 1;
+		frame->stride = m_record.header.width;
+		frame->captureTimeUs = m_record.header.captureTimeUs;
+		osvrTimeValueGetNow(&frame->arrivalTime);
+		frame->depth = m_record.header.hasDepth ? m_record.depth.data() : NULL;
+		frame->depthStride = m_record.header.width * sizeof(uint16_t);
+		m_hasRecord = false;
+		return true;
+	}
+	void SessionFrameSource::releaseFrame() {
+	}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// OpenCV is required for reading the webcam
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "SessionRecording.h"
+#include "SharedFrameRing.h"
+#include "ThreadPlacement.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// A frame borrowed from a source. It stays valid until releaseFrame() is called.
+	struct FrameView {
+		const unsigned char* data;
+		int width;
+		int height;
+		int channels;			// 1 for greyscale, 3 for BGR
+		int stride;				// bytes per row
+		uint64_t captureTimeUs;	// source clock, 0 if the source does not know
+		OSVR_TimeValue arrivalTime;	// OSVR clock, when the frame reached the host
+		const uint16_t* depth;	// millimetres, aligned to the frame, NULL if the source has no depth
+		int depthStride;		// bytes per depth row
+	};
+
+	class IFrameSource {
+	public:
+		virtual ~IFrameSource() {}
+		virtual bool open() = 0;
+		/// Returns false when no new frame is available.
+		virtual bool acquireFrame(FrameView* frame) = 0;
+		virtual void releaseFrame() = 0;
+	};
+
+	class FrameSourceFactory {
+	public:
+		static IFrameSource* getSource(Json::Value config);
+	};
+
+	/// Reads the camera on its own capture thread so that a slow camera never blocks the tracking thread.
+	class VideoCaptureFrameSource : public IFrameSource {
+	public:
+		VideoCaptureFrameSource(int cameraIndex, ThreadPlacement capturePlacement);
+		~VideoCaptureFrameSource();
+		bool open();
+		bool acquireFrame(FrameView* frame);
+		void releaseFrame();
+	protected:
+		void captureLoop();
+
+		int m_cameraIndex;
+		ThreadPlacement m_capturePlacement;
+		cv::VideoCapture m_videoCapture;
+		std::thread m_captureThread;
+		std::atomic<bool> m_running;
+
+		std::mutex m_mutex;
+		cv::Mat m_captured;		// latest frame from the capture thread, guarded by m_mutex
+		OSVR_TimeValue m_capturedTime;
+		bool m_hasNewFrame;
+		cv::Mat m_frame;		// frame lent to the tracker
+		OSVR_TimeValue m_frameTime;
+	};
+
+	/// Reads frames published by another process into a SharedFrameRing, without copying them.
+	class SharedMemoryFrameSource : public IFrameSource {
+	public:
+		SharedMemoryFrameSource(std::string name);
+		bool open();
+		bool acquireFrame(FrameView* frame);
+		void releaseFrame();
+	protected:
+		std::string m_name;
+		SharedFrameRing m_ring;
+		std::chrono::steady_clock::time_point m_lastOpenAttempt;
+		std::chrono::steady_clock::time_point m_lastFrame;
+		bool m_reportedBadFrame;	// the first invalid frame header is logged
+	};
+
+	/// Replays a recorded session at the pace it was recorded, depth included, to run the device
+	/// without its camera. Starts over at the end of the session.
+	class SessionFrameSource : public IFrameSource {
+	public:
+		SessionFrameSource(std::string path);
+		bool open();
+		bool acquireFrame(FrameView* frame);
+		void releaseFrame();
+	protected:
+		std::string m_path;
+		SessionReader m_reader;
+		SessionRecord m_record;		// next frame, lent to the tracker once due
+		bool m_hasRecord;
+		bool m_started;
+		std::chrono::steady_clock::time_point m_replayStart;
+		uint64_t m_firstHostTimeUs;	// recorded time of the first frame of the pass
+	};
+
+}
@@ -0,0 +1,124 @@
+#include "stdafx.h"
+
+#include "FusionConfig.h"
+
+#include "CameraClock.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	static bool hasPaths(const Json::Value& value, const char* first, const char* second, const char* third) {
+		return value.isObject() && value[first].isString() && value[second].isString() && value[third].isString();
+	}
+
+	FusionConfig::FusionConfig() {
+		cameraType = 0;
+		position = POSITION_KUDAN;
+		orientation = ORIENTATION_SINGLE;
+		timestamp = TIMESTAMP_NONE;
+		hasMarkers = false;
+		useScheduler = false;
+		useTelemetry = false;
+		reloadInterval = 500;
+	}
+
+	bool FusionConfig::parse(const Json::Value& config, FusionConfig* fusionConfig, std::string* error) {
+		if (!config.isObject()) {
+			*error = "params must be an object";
+			return false;
+		}
+		fusionConfig->json = config;
+
+		if (!config["name"].isString() || config["name"].asString().empty()) {
+			*error = "\"name\" must be a non empty string";
+			return false;
+		}
+		fusionConfig->name = config["name"].asString();
+
+		const Json::Value& orientation = config["orientation"];
+		if (orientation.isString()) {
+			fusionConfig->orientation = ORIENTATION_SINGLE;
+		}
+		else if (hasPaths(orientation, "roll", "pitch", "yaw")) {
+			fusionConfig->orientation = ORIENTATION_COMBINED;
+		}
+		else {
+			*error = "\"orientation\" must be a path or an object with \"roll\", \"pitch\" and \"yaw\" paths";
+			return false;
+		}
+
+		const Json::Value& position = config["position"];
+		if (position.isString() && position.asString().empty()) {
+			fusionConfig->position = POSITION_KUDAN;
+		}
+		else if (position.isString()) {
+			fusionConfig->position = POSITION_SINGLE;
+		}
+		else if (hasPaths(position, "x", "y", "z")) {
+			fusionConfig->position = POSITION_COMBINED;
+		}
+		else {
+			*error = "\"position\" must be \"\" for Kudan, a path or an object with \"x\", \"y\" and \"z\" paths";
+			return false;
+		}
+
+		if (config.isMember("cameraType")) {
+			if (!config["cameraType"].isInt() || config["cameraType"].asInt() < 0 || config["cameraType"].asInt() > 3) {
+				*error = "\"cameraType\" must be 0 (RealSense), 1 (webcam), 2 (shared memory) or 3 (session replay)";
+				return false;
+			}
+			fusionConfig->cameraType = config["cameraType"].asInt();
+			if (fusionConfig->cameraType == 3 && !config["replaySession"].isString()) {
+				*error = "\"replaySession\" must name the session file replayed with \"cameraType\" 3";
+				return false;
+			}
+		}
+
+		fusionConfig->timestamp = TIMESTAMP_NONE;
+		if (config.isMember("timestamp")) {
+			std::string timestamp = config["timestamp"].isString() ? config["timestamp"].asString() : "";
+			if (timestamp == "position") {
+				fusionConfig->timestamp = TIMESTAMP_POSITION;
+			}
+			else if (timestamp == "orientation") {
+				fusionConfig->timestamp = TIMESTAMP_ORIENTATION;
+			}
+			else {
+				*error = "\"timestamp\" must be \"position\" or \"orientation\"";
+				return false;
+			}
+		}
+
+		if (!FusionParameters::validate(config, error)) {
+			return false;
+		}
+		fusionConfig->parameters = FusionParameters::fromConfig(config);
+
+		fusionConfig->hasMarkers = config.isMember("markers");
+		fusionConfig->useScheduler = config.isMember("scheduler");
+		fusionConfig->useTelemetry = config.isMember("telemetry");
+
+		if (config.isMember("cameraClock") && !CameraClock::validate(config["cameraClock"], error)) {
+			return false;
+		}
+
+		fusionConfig->reloadFile.clear();
+		if (config.isMember("reload")) {
+			const Json::Value& reload = config["reload"];
+			if (!reload["file"].isString() || reload["file"].asString().empty()) {
+				*error = "\"reload\" must have a \"file\" path";
+				return false;
+			}
+			fusionConfig->reloadFile = reload["file"].asString();
+			if (reload.isMember("interval")) {
+				if (!reload["interval"].isInt() || reload["interval"].asInt() < 10) {
+					*error = "\"reload.interval\" must be an integer of at least 10 (ms)";
+					return false;
+				}
+				fusionConfig->reloadInterval = reload["interval"].asInt();
+			}
+		}
+
+		return true;
+	}
+
+}
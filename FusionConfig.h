@@ -0,0 +1,51 @@
+#pragma once
+#include "stdafx.h"
+
+#include "FusionParameters.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	enum PositionSourceType {
+		POSITION_KUDAN,		// "position": "", tracked by Kudan
+		POSITION_SINGLE,	// "position": "<path>"
+		POSITION_COMBINED	// "position": { "x", "y", "z" }, one path per axis
+	};
+
+	enum OrientationSourceType {
+		ORIENTATION_SINGLE,		// "orientation": "<path>"
+		ORIENTATION_COMBINED	// "orientation": { "roll", "pitch", "yaw" }, one path per axis
+	};
+
+	enum TimestampSource {
+		TIMESTAMP_NONE,			// no "timestamp", the server stamps the pose
+		TIMESTAMP_POSITION,		// "timestamp": "position"
+		TIMESTAMP_ORIENTATION	// "timestamp": "orientation"
+	};
+
+	/// Device params of TrackerKudanFusion, parsed and validated once. Components with their own
+	/// sub-config (frame source, markers, threads, scheduler, telemetry) read it from json.
+	struct FusionConfig {
+		FusionConfig();
+
+		std::string name;
+		int cameraType;			// 0 RealSense, 1 webcam, 2 shared memory, 3 session replay, used with POSITION_KUDAN
+		PositionSourceType position;
+		OrientationSourceType orientation;
+		TimestampSource timestamp;
+		FusionParameters parameters;
+
+		bool hasMarkers;
+		bool useScheduler;
+		bool useTelemetry;
+
+		/// "reload": { "file", "interval" (ms) }, empty file when parameters are not reloadable.
+		std::string reloadFile;
+		int reloadInterval;
+
+		Json::Value json;
+
+		/// Parses config into the struct. On error the struct is left partially set and error tells why.
+		static bool parse(const Json::Value& config, FusionConfig* fusionConfig, std::string* error);
+	};
+
+}
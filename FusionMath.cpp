@@ -26,4 +26,11 @@ namespace com_samaust_trackerkudan_osvr {
 		osvrQuatSetW(quaternion, cos(r / 2) * cos(p / 2) * cos(y / 2) + sin(r / 2) * sin(p / 2) * sin(y / 2));
 	}
 
+	void applyRotationCenterOffset(OSVR_PoseState* pose, const OSVR_Vec3* offset) {
+		Eigen::Quaterniond rotation = osvr::util::fromQuat(pose->rotation);
+		Eigen::Map<Eigen::Vector3d> translation = osvr::util::vecMap(pose->translation);
+
+		translation += rotation._transformVector(osvr::util::vecMap(*offset));
+	}
+
 }
\ No newline at end of file
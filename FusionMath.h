@@ -4,5 +4,7 @@ namespace com_samaust_trackerkudan_osvr {
 
 	void rpyFromQuaternion(OSVR_Quaternion* quaternion, OSVR_Vec3* rpy);
 	void quaternionFromRPY(OSVR_Vec3* rpy, OSVR_Quaternion* quaternion);
+	/// Moves the tracked point from the rotation center to the eyes, offset given in the head frame.
+	void applyRotationCenterOffset(OSVR_PoseState* pose, const OSVR_Vec3* offset);
 
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "stdafx.h"
+
+#include "FusionParameters.h"
+
+#include <sstream>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	FusionParameters::FusionParameters() {
+		processingScale = 1.0;
+		roiSize = 1.0;
+		roiLookahead = 4.0;
+		filterAlpha = 1.0;
+		filterBeta = 0.5;
+		predictionHorizon = 0.0;
+		useOffset = false;
+		osvrVec3Zero(&offset);
+	}
+
+	FusionParameters FusionParameters::fromConfig(const Json::Value& config) {
+		FusionParameters parameters;
+
+		parameters.processingScale = config.get("processingScale", parameters.processingScale).asDouble();
+		if (config.isMember("roi")) {
+			parameters.roiSize = config["roi"].get("size", parameters.roiSize).asDouble();
+			parameters.roiLookahead = config["roi"].get("lookahead", parameters.roiLookahead).asDouble();
+		}
+		if (config.isMember("filter")) {
+			parameters.filterAlpha = config["filter"].get("alpha", parameters.filterAlpha).asDouble();
+			parameters.filterBeta = config["filter"].get("beta", parameters.filterBeta).asDouble();
+		}
+		parameters.predictionHorizon = config.get("predictionHorizon", parameters.predictionHorizon).asDouble();
+
+		if ((parameters.useOffset = config.isMember("offsetFromRotationCenter"))) {
+			if (config["offsetFromRotationCenter"].isMember("x")) {
+				osvrVec3SetX(&parameters.offset, config["offsetFromRotationCenter"]["x"].asDouble());
+			}
+			if (config["offsetFromRotationCenter"].isMember("y")) {
+				osvrVec3SetY(&parameters.offset, config["offsetFromRotationCenter"]["y"].asDouble());
+			}
+			if (config["offsetFromRotationCenter"].isMember("z")) {
+				osvrVec3SetZ(&parameters.offset, config["offsetFromRotationCenter"]["z"].asDouble());
+			}
+		}
+
+		return parameters;
+	}
+
+	static bool checkNumber(const Json::Value& value, const char* name, double min, double max, bool minIncluded, std::string* error) {
+		std::ostringstream message;
+		if (!value.isNumeric()) {
+			message << "\"" << name << "\" must be a number";
+		}
+		else if (value.asDouble() > max || value.asDouble() < min || (!minIncluded && value.asDouble() == min)) {
+			message << "\"" << name << "\" must be in " << (minIncluded ? "[" : "]") << min << ", " << max << "], got " << value.asDouble();
+		}
+		else {
+			return true;
+		}
+		*error = message.str();
+		return false;
+	}
+
+	bool FusionParameters::validate(const Json::Value& config, std::string* error) {
+		if (config.isMember("processingScale") && !checkNumber(config["processingScale"], "processingScale", 0, 2, false, error)) {
+			return false;
+		}
+		if (config.isMember("roi")) {
+			const Json::Value& roi = config["roi"];
+			if (!roi.isObject()) {
+				*error = "\"roi\" must be an object with \"size\" and \"lookahead\"";
+				return false;
+			}
+			if (roi.isMember("size") && !checkNumber(roi["size"], "roi.size", 0.25, 1, true, error)) {
+				return false;
+			}
+			if (roi.isMember("lookahead") && !checkNumber(roi["lookahead"], "roi.lookahead", 0, 30, true, error)) {
+				return false;
+			}
+		}
+		if (config.isMember("filter")) {
+			const Json::Value& filter = config["filter"];
+			if (!filter.isObject()) {
+				*error = "\"filter\" must be an object with \"alpha\" and \"beta\"";
+				return false;
+			}
+			if (filter.isMember("alpha") && !checkNumber(filter["alpha"], "filter.alpha", 0, 1, false, error)) {
+				return false;
+			}
+			if (filter.isMember("beta") && !checkNumber(filter["beta"], "filter.beta", 0, 1, true, error)) {
+				return false;
+			}
+		}
+		if (config.isMember("predictionHorizon") && !checkNumber(config["predictionHorizon"], "predictionHorizon", 0, 0.5, true, error)) {
+			return false;
+		}
+		if (config.isMember("offsetFromRotationCenter")) {
+			const Json::Value& offset = config["offsetFromRotationCenter"];
+			if (!offset.isObject()) {
+				*error = "\"offsetFromRotationCenter\" must be an object with \"x\", \"y\" and \"z\"";
+				return false;
+			}
+			const char* axes[] = { "x", "y", "z" };
+			for (int i = 0; i < 3; i++) {
+				std::string name = std::string("offsetFromRotationCenter.") + axes[i];
+				if (offset.isMember(axes[i]) && !checkNumber(offset[axes[i]], name.c_str(), -1, 1, true, error)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	Json::Value FusionParameters::toConfig() const {
+		Json::Value config;
+
+		config["processingScale"] = processingScale;
+		config["roi"]["size"] = roiSize;
+		config["roi"]["lookahead"] = roiLookahead;
+		config["filter"]["alpha"] = filterAlpha;
+		config["filter"]["beta"] = filterBeta;
+		config["predictionHorizon"] = predictionHorizon;
+		if (useOffset) {
+			config["offsetFromRotationCenter"]["x"] = osvrVec3GetX(&offset);
+			config["offsetFromRotationCenter"]["y"] = osvrVec3GetY(&offset);
+			config["offsetFromRotationCenter"]["z"] = osvrVec3GetZ(&offset);
+		}
+
+		return config;
+	}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "stdafx.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Tunable parameters of the fusion pipeline, as found in the device params.
+	struct FusionParameters {
+		FusionParameters();
+
+		double processingScale;		// "processingScale": tracked frame size / camera frame size
+		double roiSize;				// "roi": { "size", "lookahead" }, see RoiSelector
+		double roiLookahead;
+		double filterAlpha;			// "filter": { "alpha", "beta" }, see PositionFilter
+		double filterBeta;
+		double predictionHorizon;	// "predictionHorizon", s
+		bool useOffset;				// "offsetFromRotationCenter": { "x", "y", "z" }, m
+		OSVR_Vec3 offset;
+
+		/// Reads the parameters, defaults for the missing ones. The config must be valid.
+		static FusionParameters fromConfig(const Json::Value& config);
+		/// Checks the types and ranges of the parameters present in config, error tells the first problem.
+		static bool validate(const Json::Value& config, std::string* error);
+		/// Device params snippet holding these parameters.
+		Json::Value toConfig() const;
+	};
+
+}
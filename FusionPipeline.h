@@ -0,0 +1,133 @@
+#pragma once
+#include "stdafx.h"
+
+#include <memory>
+
+#include "FusionConfig.h"
+#include "FusionParameters.h"
+#include "PositionFilter.h"
+#include "TelemetryTap.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Everything a policy may need to set itself up, resolved once when the device is created.
+	struct FusionContext {
+		OSVR_ClientContext clientContext;
+		Json::Value config;
+		FusionParameters parameters;
+		TimestampSource timestamp;	// of the poses sent
+		osvr::pluginkit::DeviceToken* device;
+		OSVR_TrackerDeviceInterface tracker;
+		std::shared_ptr<TelemetryTap> telemetry;	// NULL unless the "telemetry" device param is set
+	};
+
+	/// One fusion tick with every step chosen at compile time. Each policy is built from the
+	/// FusionContext and provides:
+	///   OrientationSource: void update(OSVR_OrientationState*, OSVR_TimeValue*)
+	///   PositionSource: bool update(OSVR_PositionState*, OSVR_OrientationState*, OSVR_TimeValue*), true for a new
+	///     position, the time it was measured at. The time may be left as is without new position.
+	///   Filter: void update(bool newPosition, const OSVR_PositionState&, const OSVR_TimeValue&, OSVR_PositionState* output)
+	///   Offset: void apply(OSVR_PoseState*)
+	///   Output: void send(const OSVR_PoseState&, const OSVR_TimeValue& position, const OSVR_TimeValue& orientation)
+	/// PositionSource, Filter and Offset also provide void setParameters(const FusionParameters&) for
+	/// pipelines whose parameters are reloaded.
+	template <class OrientationSource, class PositionSource, class Filter, class Offset, class Output>
+	class FusionPipeline {
+	public:
+		explicit FusionPipeline(FusionContext& context)
+			: m_orientation(context), m_position(context), m_filter(context), m_offset(context), m_output(context) {
+			osvrPose3SetIdentity(&m_state);
+			osvrVec3Zero(&m_trackedPosition);
+			osvrTimeValueGetNow(&m_timeValuePosition);
+			m_timeValueOrientation = m_timeValuePosition;
+		}
+
+		void update() {
+			m_orientation.update(&m_state.rotation, &m_timeValueOrientation);
+			bool newPosition = m_position.update(&m_trackedPosition, &m_state.rotation, &m_timeValuePosition);
+			m_filter.update(newPosition, m_trackedPosition, m_timeValuePosition, &m_state.translation);
+			m_offset.apply(&m_state);
+			m_output.send(m_state, m_timeValuePosition, m_timeValueOrientation);
+		}
+
+		/// Between two updates.
+		void setParameters(const FusionParameters& parameters) {
+			m_position.setParameters(parameters);
+			m_filter.setParameters(parameters);
+			m_offset.setParameters(parameters);
+		}
+
+		const OSVR_PoseState& state() const { return m_state; }
+
+		/// The sources, for the replays of trackerkudan_sweep that feed them recorded frames.
+		OrientationSource& orientationSource() { return m_orientation; }
+		PositionSource& positionSource() { return m_position; }
+
+	private:
+		OrientationSource m_orientation;
+		PositionSource m_position;
+		Filter m_filter;
+		Offset m_offset;
+		Output m_output;
+
+		OSVR_PoseState m_state;
+		OSVR_PositionState m_trackedPosition;	// before filtering and offset
+		// Times of the last position and orientation, kept between updates without new ones
+		OSVR_TimeValue m_timeValuePosition;
+		OSVR_TimeValue m_timeValueOrientation;
+	};
+
+	/// Position goes out as tracked.
+	class PassThroughFilter {
+	public:
+		explicit PassThroughFilter(FusionContext&) {}
+		void update(bool, const OSVR_PositionState& position, const OSVR_TimeValue&, OSVR_PositionState* output) {
+			*output = position;
+		}
+		void setParameters(const FusionParameters&) {}
+	};
+
+	/// Smoothing and prediction of PositionFilter.
+	class SmoothingFilter {
+	public:
+		explicit SmoothingFilter(FusionContext& context)
+			: m_filter(context.parameters.filterAlpha, context.parameters.filterBeta, context.parameters.predictionHorizon) {}
+		void setParameters(const FusionParameters& parameters) {
+			m_filter.setParameters(parameters.filterAlpha, parameters.filterBeta, parameters.predictionHorizon);
+		}
+		void update(bool newPosition, const OSVR_PositionState& position, const OSVR_TimeValue& time, OSVR_PositionState* output) {
+			if (newPosition) {
+				m_filter.addMeasurement(position, time.seconds + time.microseconds / 1e6);
+			}
+			if (m_filter.hasMeasurement()) {
+				m_filter.predict(output);
+			}
+			else {
+				*output = position;
+			}
+		}
+	private:
+		PositionFilter m_filter;
+	};
+
+	class NoOffset {
+	public:
+		explicit NoOffset(FusionContext&) {}
+		void apply(OSVR_PoseState*) {}
+		void setParameters(const FusionParameters&) {}
+	};
+
+	class RotationCenterOffset {
+	public:
+		explicit RotationCenterOffset(FusionContext& context) : m_offset(context.parameters.offset) {}
+		void apply(OSVR_PoseState* pose) {
+			applyRotationCenterOffset(pose, &m_offset);
+		}
+		void setParameters(const FusionParameters& parameters) {
+			m_offset = parameters.offset;
+		}
+	private:
+		OSVR_Vec3 m_offset;
+	};
+
+}
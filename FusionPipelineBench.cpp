@@ -0,0 +1,285 @@
+// Per update overhead of the compile-time FusionPipeline against the update of TrackerKudanFusion at
+// the baseline commit, both fed by the same synthetic readers.
+// The baseline update is copied, not linked: the OSVR client update is left out and the pose goes to a
+// sink instead of osvrDeviceTrackerSendPose, on both sides. The baseline had no position filter, the
+// filtered pipeline is timed alone.
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FusionConfig.h"
+#include "FusionParameters.h"
+#include "FusionPipeline.h"
+
+using namespace com_samaust_trackerkudan_osvr;
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kTableSize = 1024;
+
+static void usage() {
+	std::cout << "Usage: trackerkudan_pipeline_bench [options]" << std::endl
+		<< "  --updates <n>       updates per run (default 20000000)" << std::endl
+		<< "  --runs <n>          runs per variant, the fastest is reported (default 5)" << std::endl
+		<< "  --every <n>         updates per new position (default 2)" << std::endl;
+}
+
+// Slowly turning head, precomputed so that the readers cost next to nothing
+class SyntheticOrientationReader final : public IOrientationReader {
+public:
+	SyntheticOrientationReader() : m_index(0) {
+		for (int i = 0; i < kTableSize; i++) {
+			OSVR_Vec3 rpy;
+			osvrVec3SetX(&rpy, 0.1 * std::sin(i * 0.01));
+			osvrVec3SetY(&rpy, 0.2 * std::sin(i * 0.02));
+			osvrVec3SetZ(&rpy, 0.5 * std::sin(i * 0.005));
+			OSVR_Quaternion quaternion;
+			quaternionFromRPY(&rpy, &quaternion);
+			m_table.push_back(quaternion);
+		}
+	}
+	OSVR_ReturnCode update(OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+		*orientation = m_table[m_index++ % kTableSize];
+		timeValue->seconds = m_index / 1000;
+		timeValue->microseconds = (m_index % 1000) * 1000;
+		return OSVR_RETURN_SUCCESS;
+	}
+private:
+	std::vector<OSVR_Quaternion> m_table;
+	unsigned int m_index;
+};
+
+// New position every `every` updates, one update per millisecond
+class SyntheticPositionReader final : public IPositionReader {
+public:
+	explicit SyntheticPositionReader(int every) : m_every(every), m_index(0) {
+		for (int i = 0; i < kTableSize; i++) {
+			OSVR_PositionState position;
+			osvrVec3SetX(&position, 0.05 * std::sin(i * 0.03));
+			osvrVec3SetY(&position, 0.02 * std::sin(i * 0.05));
+			osvrVec3SetZ(&position, 0.5 + 0.05 * std::sin(i * 0.01));
+			m_table.push_back(position);
+		}
+	}
+	OSVR_ReturnCode update(OSVR_PositionState* position, OSVR_TimeValue* timeValue) {
+		unsigned int index = m_index++;
+		if (index % m_every != 0) {
+			return OSVR_RETURN_FAILURE;
+		}
+		*position = m_table[(index / m_every) % kTableSize];
+		timeValue->seconds = index / 1000;
+		timeValue->microseconds = (index % 1000) * 1000;
+		return OSVR_RETURN_SUCCESS;
+	}
+private:
+	std::vector<OSVR_PositionState> m_table;
+	unsigned int m_every;
+	unsigned int m_index;
+};
+
+// Stands in for osvrDeviceTrackerSendPose, keeps the output alive
+static double g_sink = 0;
+static void sendPose(const OSVR_PoseState& state, const OSVR_TimeValue* timeValue) {
+	g_sink += osvrVec3GetX(&state.translation) + osvrQuatGetW(&state.rotation);
+	if (timeValue) {
+		g_sink += timeValue->microseconds * 1e-12;
+	}
+}
+
+// TrackerKudanFusion::update() of the baseline commit, external position reader only
+class BaselineFusion {
+public:
+	BaselineFusion(IOrientationReader* orientationReader, IPositionReader* positionReader, const Json::Value& config) {
+		osvrPose3SetIdentity(&m_state);
+		m_orientationReader = orientationReader;
+		m_positionReader = positionReader;
+		m_useTimestamp = config.isMember("timestamp");
+		m_usePositionTimestamp = m_useTimestamp && config["timestamp"].asString().compare("position") == 0;
+		m_useOffset = config.isMember("offsetFromRotationCenter");
+		osvrVec3Zero(&m_offset);
+		if (m_useOffset) {
+			osvrVec3SetX(&m_offset, config["offsetFromRotationCenter"]["x"].asDouble());
+			osvrVec3SetY(&m_offset, config["offsetFromRotationCenter"]["y"].asDouble());
+			osvrVec3SetZ(&m_offset, config["offsetFromRotationCenter"]["z"].asDouble());
+		}
+		// Members rather than locals as in the baseline, where the position time was read uninitialised without new position
+		m_timeValuePosition.seconds = 0;
+		m_timeValuePosition.microseconds = 0;
+		m_timeValueOrientation = m_timeValuePosition;
+	}
+
+	void update() {
+		m_orientationReader->update(&m_state.rotation, &m_timeValueOrientation);
+		m_positionReader->update(&m_state.translation, &m_timeValuePosition);
+
+		if (m_useOffset) {
+			Eigen::Quaterniond rotation = osvr::util::fromQuat(m_state.rotation);
+			Eigen::Map<Eigen::Vector3d> translation = osvr::util::vecMap(m_state.translation);
+
+			translation += rotation._transformVector(osvr::util::vecMap(m_offset));
+		}
+
+		if (m_useTimestamp) {
+			OSVR_TimeValue timeValue = m_usePositionTimestamp ? m_timeValuePosition : m_timeValueOrientation;
+			sendPose(m_state, &timeValue);
+		}
+		else {
+			sendPose(m_state, NULL);
+		}
+	}
+
+private:
+	IOrientationReader* m_orientationReader;
+	IPositionReader* m_positionReader;
+	OSVR_PoseState m_state;
+	OSVR_TimeValue m_timeValuePosition;
+	OSVR_TimeValue m_timeValueOrientation;
+	bool m_useTimestamp;
+	bool m_usePositionTimestamp;
+	bool m_useOffset;
+	OSVR_Vec3 m_offset;
+};
+
+static int g_every = 2;
+
+class SyntheticOrientation {
+public:
+	explicit SyntheticOrientation(FusionContext&) {}
+	void update(OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+		m_reader.update(orientation, timeValue);
+	}
+private:
+	SyntheticOrientationReader m_reader;
+};
+
+class SyntheticPosition {
+public:
+	explicit SyntheticPosition(FusionContext&) : m_reader(g_every) {}
+	bool update(OSVR_PositionState* position, OSVR_OrientationState*, OSVR_TimeValue* timeValue) {
+		return m_reader.update(position, timeValue) == OSVR_RETURN_SUCCESS;
+	}
+private:
+	SyntheticPositionReader m_reader;
+};
+
+// PoseOutput with the sink, the same runtime flags
+class SinkOutput {
+public:
+	explicit SinkOutput(FusionContext& context) : m_timestamp(context.timestamp), m_telemetry(context.telemetry.get()) {}
+	void send(const OSVR_PoseState& state, const OSVR_TimeValue& timeValuePosition, const OSVR_TimeValue& timeValueOrientation) {
+		if (m_timestamp == TIMESTAMP_NONE) {
+			sendPose(state, NULL);
+		}
+		else {
+			sendPose(state, m_timestamp == TIMESTAMP_POSITION ? &timeValuePosition : &timeValueOrientation);
+		}
+		if (m_telemetry) {
+			m_telemetry->publishPose(state.translation.data, state.rotation.data);
+		}
+	}
+private:
+	TimestampSource m_timestamp;
+	TelemetryTap* m_telemetry;
+};
+
+// Fastest of the runs, in ns per update
+template <class Fusion>
+static double timeUpdates(Fusion& fusion, int updates, int runs) {
+	double best = 1e30;
+	for (int run = 0; run < runs; run++) {
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < updates; i++) {
+			fusion.update();
+		}
+		double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / updates;
+		best = std::min(best, ns);
+	}
+	return best;
+}
+
+template <class Pipeline>
+static double timePipeline(const Json::Value& config, int updates, int runs) {
+	FusionConfig fusionConfig;
+	std::string error;
+	if (!FusionConfig::parse(config, &fusionConfig, &error)) {
+		std::cerr << "[TrackerKudan-OSVR] " << error << std::endl;
+		std::exit(1);
+	}
+	FusionContext context;
+	context.clientContext = NULL;
+	context.config = config;
+	context.parameters = fusionConfig.parameters;
+	context.timestamp = fusionConfig.timestamp;
+	context.device = NULL;
+	Pipeline pipeline(context);
+	return timeUpdates(pipeline, updates, runs);
+}
+
+template <class Pipeline>
+static void compare(const std::string& label, const Json::Value& config, int updates, int runs) {
+	SyntheticOrientationReader orientationReader;
+	SyntheticPositionReader positionReader(g_every);
+	BaselineFusion baseline(&orientationReader, &positionReader, config);
+
+	double baselineNs = timeUpdates(baseline, updates, runs);
+	double pipelineNs = timePipeline<Pipeline>(config, updates, runs);
+
+	std::cout << label << ": baseline " << baselineNs << " ns, pipeline " << pipelineNs << " ns, "
+		<< (baselineNs - pipelineNs) << " ns saved per update" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	int updates = 20000000;
+	int runs = 5;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--updates" && i + 1 < argc) {
+			updates = std::atoi(argv[++i]);
+		}
+		else if (arg == "--runs" && i + 1 < argc) {
+			runs = std::atoi(argv[++i]);
+		}
+		else if (arg == "--every" && i + 1 < argc) {
+			g_every = std::atoi(argv[++i]);
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (updates < 1 || runs < 1 || g_every < 1) {
+		usage();
+		return 1;
+	}
+
+	Json::Value plain;
+	plain["name"] = "Bench";
+	plain["orientation"] = "/synthetic/orientation";
+	plain["position"] = "/synthetic/position";
+	compare<FusionPipeline<SyntheticOrientation, SyntheticPosition, PassThroughFilter, NoOffset, SinkOutput> >(
+		"pass through", plain, updates, runs);
+
+	Json::Value offset = plain;
+	offset["offsetFromRotationCenter"]["z"] = -0.1;
+	offset["timestamp"] = "position";
+	compare<FusionPipeline<SyntheticOrientation, SyntheticPosition, PassThroughFilter, RotationCenterOffset, SinkOutput> >(
+		"offset, timestamp", offset, updates, runs);
+
+	Json::Value filtered = offset;
+	filtered["filter"]["alpha"] = 0.5;
+	filtered["filter"]["beta"] = 0.3;
+	filtered["predictionHorizon"] = 0.02;
+	std::cout << "filter, offset, timestamp: pipeline "
+		<< timePipeline<FusionPipeline<SyntheticOrientation, SyntheticPosition, SmoothingFilter, RotationCenterOffset, SinkOutput> >(filtered, updates, runs)
+		<< " ns" << std::endl;
+
+	std::cout << "(checksum " << g_sink << ")" << std::endl;
+	return 0;
+}
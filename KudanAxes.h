@@ -0,0 +1,18 @@
+#pragma once
+#include "stdafx.h"
+
+// include the Kudan Tracker Interface
+#include "KudanCV.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Kudan positions are in cm with the camera axes: x right, y down, z forward.
+	const double kKudanUnitsPerMetre = 100.0;
+
+	/// Kudan camera axes to OSVR axes (x right, y up, z backward), in metres. Both Kudan trackers
+	/// report where their target is relative to the camera, the head is at minus that.
+	inline Eigen::Vector3d kudanToOsvr(const KudanVector3& position) {
+		return Eigen::Vector3d(position.x, -position.y, -position.z) / kKudanUnitsPerMetre;
+	}
+
+}
@@ -0,0 +1,391 @@
+#include "stdafx.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Standard includes
+#include <cmath>
+#include <iostream>
+
+#include "KudanPositionTracker.h"
+
+
+/// Add your Kudan license key here
+const std::string kLicenseKey = "";
+
+/// Largest gap between an Arbitrack position and its constant velocity prediction still trusted, cm
+const double kMaxInnovation = 2.0;
+
+/// Distance of the scene assumed when no depth is known, m
+const double kDefaultStartDistance = 2.0;
+/// Centred part of the frame whose depth is the start distance
+const double kStartDepthWindow = 0.5;
+/// Frames waited for a usable depth image before starting at the assumed distance
+const unsigned int kMaxDepthWaitFrames = 30;
+/// Confident full frames a window would fit, about two seconds, before Arbitrack restarts on a window again
+const unsigned int kCalmFrames = 60;
+
+
+namespace com_samaust_trackerkudan_osvr {
+
+	KudanPositionTracker::KudanPositionTracker(MarkerCorrector* markerCorrector, TelemetryTap* telemetry, double processingScale) {
+		m_markerCorrector = markerCorrector;
+		m_telemetry = telemetry;
+		m_processingScale = processingScale > 0 ? processingScale : 1.0;
+		m_requestedScale = 0;
+		m_roiRequested = false;
+		m_requestedRoiSize = 1;
+		m_requestedRoiLookahead = 0;
+		m_focal = 0;
+		m_confident = true;
+		m_calmFrames = 0;
+		m_roiRestarts = 0;
+		m_hasLastPosition = false;
+		m_isRunningArbitrack = false;
+		m_doStartArbitrack = false;
+		m_depthWaitFrames = 0;
+		m_recenterHotkey = false;
+		m_x_recenter = 0;
+		m_y_recenter = 0;
+		m_z_recenter = static_cast<float>(-kDefaultStartDistance);
+		m_trackedFrames = 0;
+		m_frames = 0;
+		m_framesToStableScale = 0;
+	}
+
+	KudanCameraParameters KudanPositionTracker::frameParameters() const {
+		// Set up the intrinsics, by setting the size, and using the function to guess the intrinsics (if they are known, use setIntrinsics())
+		KudanCameraParameters cameraParameters;
+		cameraParameters.setSize(m_frameSize.width, m_frameSize.height);
+		cameraParameters.guessIntrinsics();
+		return cameraParameters;
+	}
+
+	KudanCameraParameters KudanPositionTracker::cameraParameters() const {
+		KudanCameraParameters cameraParameters = frameParameters();
+		if (m_roi.size() == m_frameSize) {
+			return cameraParameters;
+		}
+		// Same camera seen through the window: same focal length, principal point relative to the window origin
+		KudanCameraParameters window;
+		window.setSize(m_roi.width, m_roi.height);
+		window.setIntrinsics(cameraParameters.getFocalX(), cameraParameters.getFocalY(),
+			cameraParameters.getPrincipalX() - m_roi.x, cameraParameters.getPrincipalY() - m_roi.y);
+		return window;
+	}
+
+	void KudanPositionTracker::init(cv::Size frameSize) {
+		bool reinit = m_cameraSize.area() > 0;
+		m_cameraSize = frameSize;
+		m_frameSize.width = static_cast<int>(std::lround(frameSize.width * m_processingScale));
+		m_frameSize.height = static_cast<int>(std::lround(frameSize.height * m_processingScale));
+		if (m_processingScale != 1.0) {
+			std::cout << "[TrackerKudan-OSVR] Tracking at resolution " << m_frameSize.width << " x " << m_frameSize.height << std::endl;
+		}
+		m_roi = cv::Rect(cv::Point(0, 0), m_frameSize);
+
+		try {
+			KudanCameraParameters cameraParameters = this->cameraParameters();
+			m_focal = cameraParameters.getFocalX();
+
+			// The image tracker runs on its own thread, only when markers are configured
+			if (m_markerCorrector && reinit) {
+				m_markerCorrector->setCameraParameters(frameParameters());
+			}
+			else if (m_markerCorrector && !m_markerCorrector->init(cameraParameters, kLicenseKey)) {
+				std::cout << "[TrackerKudan-OSVR] No marker loaded, running without drift correction" << std::endl;
+				m_markerCorrector = NULL;
+			}
+
+			// Also want to be able to run arbitrack
+			m_arbiTracker.setApiKey(kLicenseKey);
+			m_arbiTracker.setCameraParameters(cameraParameters);
+
+			m_isRunningArbitrack = false;
+			m_doStartArbitrack = true;
+
+			std::cout << "[TrackerKudan-OSVR] Tracker initialized" << std::endl;
+		}
+		catch (KudanException &e) {
+			printf("[TrackerKudan-OSVR] Tracker initialization failed. Caught exception: %s \n", e.what());
+		}
+	}
+
+	void KudanPositionTracker::requestProcessingScale(double processingScale) {
+		m_requestedScale = processingScale;
+	}
+
+	void KudanPositionTracker::requestRoi(double size, double lookahead) {
+		std::lock_guard<std::mutex> lock(m_roiRequestMutex);
+		m_requestedRoiSize = size;
+		m_requestedRoiLookahead = lookahead;
+		m_roiRequested = true;
+	}
+
+	void KudanPositionTracker::applyProcessingScale(double processingScale) {
+		m_processingScale = processingScale;
+		m_frameSize.width = static_cast<int>(std::lround(m_cameraSize.width * m_processingScale));
+		m_frameSize.height = static_cast<int>(std::lround(m_cameraSize.height * m_processingScale));
+		m_focal = frameParameters().getFocalX();
+		// Arbitrack restarts here anyway, the window may change with it
+		m_roi = m_isRunningArbitrack ? m_roiSelector.select(m_frameSize, m_focal, m_confident) : cv::Rect(cv::Point(0, 0), m_frameSize);
+
+		// Same pose, the intrinsics scale with the frame so the position units do not change
+		if (reconfigure()) {
+			std::cout << "[TrackerKudan-OSVR] Tracking at resolution " << m_frameSize.width << " x " << m_frameSize.height << std::endl;
+		}
+	}
+
+	bool KudanPositionTracker::reconfigure() {
+		try {
+			m_arbiTracker.setCameraParameters(cameraParameters());
+			if (m_isRunningArbitrack) {
+				m_arbiTracker.start(m_arbiTracker.getPosition(), m_arbiTracker.getOrientation());
+			}
+			return true;
+		}
+		catch (KudanException &e) {
+			printf("[TrackerKudan-OSVR] Camera parameters change failed. Caught exception: %s \n", e.what());
+			return false;
+		}
+	}
+
+	void KudanPositionTracker::selectRoi(bool confident) {
+		m_roi = m_roiSelector.select(m_frameSize, m_focal, confident);
+		m_calmFrames = 0;
+		m_arbiTracker.setCameraParameters(cameraParameters());
+	}
+
+	void KudanPositionTracker::followRoi() {
+		cv::Rect full(cv::Point(0, 0), m_frameSize);
+		cv::Rect roi = m_roi;
+		if (m_roi != full) {
+			if (!m_confident || !m_roiSelector.fits(m_roi, m_frameSize, m_focal)) {
+				roi = full;
+			}
+		}
+		else {
+			cv::Rect window = m_roiSelector.select(m_frameSize, m_focal, m_confident);
+			m_calmFrames = window != full ? m_calmFrames + 1 : 0;
+			if (m_calmFrames >= kCalmFrames) {
+				roi = window;
+			}
+		}
+		if (roi == m_roi) {
+			return;
+		}
+		m_roi = roi;
+		m_calmFrames = 0;
+		m_roiRestarts++;
+		reconfigure();
+	}
+
+	void KudanPositionTracker::updateConfidence(const KudanVector3& arbitrackPosition) {
+		Eigen::Vector3d measured(arbitrackPosition.x, arbitrackPosition.y, arbitrackPosition.z);
+		if (m_hasLastPosition) {
+			m_confident = (measured - (m_lastPosition + m_lastVelocity)).norm() < kMaxInnovation;
+			m_lastVelocity = measured - m_lastPosition;
+		}
+		else {
+			m_lastVelocity.setZero();
+		}
+		m_lastPosition = measured;
+		m_hasLastPosition = true;
+	}
+
+	void KudanPositionTracker::startArbitrack(double distance, const OSVR_OrientationState& orientation) {
+		m_isRunningArbitrack = true;
+
+		// Start via a position and quaternion:
+		//                    KudanVector3 startPosition(0,0,200); // in front of the camera
+		//                    KudanQuaternion startOrientation(1,0,0,0); // without rotation
+		//                    m_arbiTracker.start(startPosition, startOrientation);
+
+		// Start via a 4x4 matrix:
+		// Set to identity:
+		KudanMatrix4 transform;
+		for (int i = 0; i < 4; i++) {
+			transform(i, i) = 1.0;
+		}
+		// z coordinate of T, in third column. At the distance of the scene Arbitrack tracks in kKudanUnitsPerMetre.
+		transform(2, 3) = static_cast<float>(distance * kKudanUnitsPerMetre);
+
+		selectRoi(true);
+		m_arbiTracker.start(transform);
+		m_scaleMonitor.restart(orientation);
+		m_hasLastPosition = false;
+		m_confident = true;
+
+		// Positions start from zero
+		m_x_recenter = 0;
+		m_y_recenter = 0;
+		m_z_recenter = static_cast<float>(-distance);
+
+		printf("[TrackerKudan-OSVR] Starting Arbitrack from here, %.2f m in front of the camera \n", distance);
+	}
+
+	bool KudanPositionTracker::checkScale(const cv::Mat& depth, const OSVR_OrientationState& orientation, const KudanVector3& arbitrackPosition) {
+		double trackedDistance = sqrt(arbitrackPosition.x * arbitrackPosition.x + arbitrackPosition.y * arbitrackPosition.y
+			+ arbitrackPosition.z * arbitrackPosition.z) / kKudanUnitsPerMetre;
+		double correction = 1;
+		bool corrected = m_scaleMonitor.check(depth, orientation, trackedDistance, &correction);
+
+		if (m_framesToStableScale == 0 && m_scaleMonitor.confirmed()) {
+			m_framesToStableScale = m_frames;
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_firstFrameTime).count();
+			std::cout << "[TrackerKudan-OSVR] Depth confirmed the position scale " << m_frames << " frames (" << seconds << " s) after the first frame" << std::endl;
+		}
+		if (!corrected) {
+			return false;
+		}
+
+		try {
+			KudanVector3 scaled(arbitrackPosition.x * correction, arbitrackPosition.y * correction, arbitrackPosition.z * correction);
+			KudanQuaternion arbitrackOrientation = m_arbiTracker.getOrientation();
+			selectRoi(m_confident);
+			m_arbiTracker.start(scaled, arbitrackOrientation);
+		}
+		catch (KudanException &e) {
+			printf("[TrackerKudan-OSVR] Scale correction failed. Caught exception: %s \n", e.what());
+			return false;
+		}
+		// The output scales around its origin, the recentring offsets with it
+		m_x_recenter = static_cast<float>(m_x_recenter * correction);
+		m_y_recenter = static_cast<float>(m_y_recenter * correction);
+		m_z_recenter = static_cast<float>(m_z_recenter * correction);
+		m_hasLastPosition = false;
+
+		std::cout << "[TrackerKudan-OSVR] Depth rescaled the positions by " << correction << std::endl;
+		return true;
+	}
+
+	bool KudanPositionTracker::processFrame(const cv::Mat& frameGrey, const OSVR_OrientationState& orientation, OSVR_PositionState* position, const cv::Mat& depth) {
+		if (m_frames++ == 0) {
+			m_firstFrameTime = std::chrono::steady_clock::now();
+		}
+
+		// Between frames, requested from another thread
+		double requestedScale = m_requestedScale.exchange(0);
+		if (requestedScale > 0 && requestedScale != m_processingScale && m_cameraSize.area() > 0) {
+			applyProcessingScale(requestedScale);
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_roiRequestMutex);
+			if (m_roiRequested) {
+				m_roiSelector.setParameters(m_requestedRoiSize, m_requestedRoiLookahead);
+				m_roiRequested = false;
+			}
+		}
+
+		cv::Mat frame = frameGrey;
+		if (frame.size() != m_frameSize) {
+			cv::resize(frameGrey, m_frameScaled, m_frameSize, 0, 0, cv::INTER_AREA);
+			frame = m_frameScaled;
+		}
+
+		uchar *imageData = frame.data;
+
+		if (m_telemetry) {
+			publishFrame(frame);
+		}
+
+		m_roiSelector.update(orientation);
+
+		if (m_isRunningArbitrack) {
+			followRoi();
+
+			// The window is tracked in place: its first pixel, and the rest of each row as padding
+			uchar *roiData = frame.ptr(m_roi.y) + m_roi.x * frame.channels();
+			int padding = static_cast<int>(frame.step) - m_roi.width * frame.channels();
+
+			KudanQuaternion orientationQuaternion = KudanQuaternion(orientation.data[1], orientation.data[2], orientation.data[3], orientation.data[0]);
+
+			m_arbiTracker.setSensedOrientation(orientationQuaternion);
+
+			// * TRACK *
+			m_arbiTracker.processFrame(roiData, m_roi.width, m_roi.height, frame.channels(), padding, false);
+
+			KudanVector3 arbitrackPosition = m_arbiTracker.getPosition();
+			if (checkScale(depth, orientation, arbitrackPosition)) {
+				arbitrackPosition = m_arbiTracker.getPosition();
+			}
+			updateConfidence(arbitrackPosition);
+			//KudanQuaternion arbitrackOrientation = m_arbiTracker.getOrientation();
+
+#ifdef _WIN32
+			// Recenter if CTRL + F12 is pressed
+			if (m_recenterHotkey && (GetAsyncKeyState(VK_CONTROL) & 0x8000))
+			{
+				if (GetAsyncKeyState(VK_F12) & 0x8000)
+				{
+					Eigen::Vector3d recenter = kudanToOsvr(arbitrackPosition);
+					m_x_recenter = static_cast<float>(recenter.x());
+					m_y_recenter = static_cast<float>(recenter.y());
+					m_z_recenter = static_cast<float>(recenter.z());
+				}
+			}
+#endif
+
+			// Return position, in m: the head is at minus the target, see kudanToOsvr
+			Eigen::Vector3d head = -kudanToOsvr(arbitrackPosition);
+			position->data[0] = head.x() + m_x_recenter;
+			position->data[1] = head.y() + m_y_recenter;
+			position->data[2] = head.z() + m_z_recenter;
+
+			if (m_telemetry) {
+				m_telemetry->publishRawPosition(position->data);
+				m_telemetry->publishTrackingState(true, m_trackedFrames + 1);
+			}
+
+			if (m_markerCorrector) {
+				m_markerCorrector->submitFrame(imageData, m_frameSize.width, m_frameSize.height, static_cast<int>(frame.step), *position, orientation);
+				m_markerCorrector->correct(position);
+			}
+
+			m_trackedFrames++;
+			return true;
+		}
+
+		// If arbitrack needs to be started, but has not been (i.e. no trackables) then do so now, from a pose in front of the camera.
+		// With depth, at the distance of the scene, waiting a few frames for a usable depth image.
+		if (m_doStartArbitrack) {
+			double distance = kDefaultStartDistance;
+			bool hasDistance = dominantDepth(depth, kStartDepthWindow, &distance);
+			if (hasDistance || depth.empty() || ++m_depthWaitFrames >= kMaxDepthWaitFrames) {
+				if (!hasDistance && !depth.empty()) {
+					std::cout << "[TrackerKudan-OSVR] No usable depth in front of the camera" << std::endl;
+				}
+				startArbitrack(distance, orientation);
+				m_depthWaitFrames = 0;
+				m_doStartArbitrack = false;
+			}
+		}
+
+		// Return position
+		position->data[0] = 0;
+		position->data[1] = 0;
+		position->data[2] = 0;
+
+		if (m_telemetry) {
+			m_telemetry->publishTrackingState(m_isRunningArbitrack, m_trackedFrames);
+		}
+
+		return false;
+	}
+
+	void KudanPositionTracker::publishFrame(const cv::Mat& frame) {
+		if (!m_telemetry->wantsFrame()) {
+			return;
+		}
+		if (frame.cols <= m_telemetry->frameWidth()) {
+			m_telemetry->publishFrame(frame.data, frame.cols, frame.rows, static_cast<int>(frame.step));
+			return;
+		}
+		int width = m_telemetry->frameWidth();
+		int height = frame.rows * width / frame.cols;
+		cv::resize(frame, m_telemetryFrame, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+		m_telemetry->publishFrame(m_telemetryFrame.data, width, height, static_cast<int>(m_telemetryFrame.step));
+	}
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// OpenCV is required for the frame buffers
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+// include the Kudan Tracker Interface
+#include "KudanCV.h"
+
+#include "KudanAxes.h"
+#include "MarkerCorrector.h"
+#include "RoiSelector.h"
+#include "SceneDepth.h"
+#include "TelemetryTap.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Arbitrack position tracking on greyscale frames, shared by the camera trackers and the offline tools.
+	class KudanPositionTracker {
+	public:
+		/// processingScale resizes the frames before tracking, 1 to track at camera resolution.
+		/// telemetry, optional, gets the raw positions, tracking state and downsampled frames.
+		KudanPositionTracker(MarkerCorrector* markerCorrector, TelemetryTap* telemetry, double processingScale);
+
+		/// Sets up Arbitrack for frames of the given camera resolution. Called again when the resolution
+		/// changes, Arbitrack then starts over.
+		void init(cv::Size frameSize);
+
+		/// Tracks one greyscale frame (row padding allowed). Returns true when position holds a new tracked position.
+		/// depth, optional, is aligned to the frame, see SceneDepth.h. With it Arbitrack starts at the
+		/// distance of the scene, in metres, and its scale is checked while it runs.
+		bool processFrame(const cv::Mat& frameGrey, const OSVR_OrientationState& orientation, OSVR_PositionState* position, const cv::Mat& depth = cv::Mat());
+
+		/// CTRL + F12 recenters on the current position (Windows). For the devices only, an offline replay
+		/// must not react to the keyboard.
+		void enableRecenterHotkey() { m_recenterHotkey = true; }
+
+		/// Number of frames tracked so far, lets callers tell a new position from a repeated one.
+		unsigned int trackedFrames() const { return m_trackedFrames; }
+
+		/// Changes the processing scale before the next frame, from any thread. Arbitrack goes on
+		/// from its current pose with the intrinsics of the new resolution.
+		void requestProcessingScale(double processingScale);
+
+		/// Tracks a window of the frames rather than the whole frames, see RoiSelector. From any thread,
+		/// both values apply together, the window changes at the next start or restart of Arbitrack. size 1
+		/// tracks full frames (default).
+		void requestRoi(double size, double lookahead);
+
+		/// Fraction of the last frame tracked, and Arbitrack restarts to change the window so far.
+		double trackedArea() const { return m_frameSize.area() > 0 ? static_cast<double>(m_roi.area()) / m_frameSize.area() : 1.0; }
+		unsigned int roiRestarts() const { return m_roiRestarts; }
+
+		/// The next frame uses a depth image, when the source has to work to get one.
+		bool wantsDepth() const { return m_doStartArbitrack || m_scaleMonitor.due(); }
+
+		/// Frames from the first one to the first depth check confirming the scale, 0 until then.
+		unsigned int framesToStableScale() const { return m_framesToStableScale; }
+
+	private:
+		/// Intrinsics of the whole tracked frame, and of the window of it Arbitrack sees.
+		KudanCameraParameters frameParameters() const;
+		KudanCameraParameters cameraParameters() const;
+		void applyProcessingScale(double processingScale);
+		/// Gives Arbitrack the intrinsics of the current window, restarting it from its current pose.
+		bool reconfigure();
+		/// Picks the window of an Arbitrack session about to start and gives Arbitrack its intrinsics.
+		void selectRoi(bool confident);
+		/// While Arbitrack runs: full frames when the window no longer fits or the tracking lost
+		/// confidence, a window again once the head has been calm for a while. Each change restarts
+		/// Arbitrack from its current pose.
+		void followRoi();
+		void updateConfidence(const KudanVector3& arbitrackPosition);
+		/// Starts Arbitrack from a pose "distance" metres in front of the camera.
+		void startArbitrack(double distance, const OSVR_OrientationState& orientation);
+		/// Depth check of the scale, restarts Arbitrack from a scaled pose when it is off. True when it did.
+		bool checkScale(const cv::Mat& depth, const OSVR_OrientationState& orientation, const KudanVector3& arbitrackPosition);
+		void publishFrame(const cv::Mat& frame);
+
+		double m_processingScale;
+		std::atomic<double> m_requestedScale;	// 0 when no change is requested
+		cv::Size m_cameraSize;
+		cv::Size m_frameSize;	// tracked size, after scaling
+		cv::Mat m_frameScaled;
+
+		RoiSelector m_roiSelector;
+		// Window parameters handed over together, under m_roiRequestMutex
+		std::mutex m_roiRequestMutex;
+		bool m_roiRequested;
+		double m_requestedRoiSize;
+		double m_requestedRoiLookahead;
+		cv::Rect m_roi;			// window of the tracked frame given to Arbitrack
+		double m_focal;			// pixels of the tracked frame
+		unsigned int m_calmFrames;	// confident full frames in a row that a window would fit
+		unsigned int m_roiRestarts;
+
+		// Constant velocity check of the Arbitrack positions, a surprise sends the window back to full frames
+		bool m_confident;
+		bool m_hasLastPosition;
+		Eigen::Vector3d m_lastPosition;
+		Eigen::Vector3d m_lastVelocity;
+
+		bool m_isRunningArbitrack;
+		bool m_doStartArbitrack;
+		unsigned int m_depthWaitFrames;	// frames waited for a usable depth before starting
+
+		DepthScaleMonitor m_scaleMonitor;
+		unsigned int m_frames;
+		unsigned int m_framesToStableScale;
+		std::chrono::steady_clock::time_point m_firstFrameTime;
+
+		KudanArbiTracker m_arbiTracker;
+
+		// Optional, absolute marker based drift correction. Not owned.
+		MarkerCorrector* m_markerCorrector;
+
+		// Optional live view. Not owned.
+		TelemetryTap* m_telemetry;
+		cv::Mat m_telemetryFrame;
+
+		bool m_recenterHotkey;
+		float m_x_recenter;
+		float m_y_recenter;
+		float m_z_recenter;
+
+		unsigned int m_trackedFrames;
+	};
+
+}
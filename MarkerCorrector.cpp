@@ -0,0 +1,203 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "MarkerCorrector.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	MarkerCorrector::MarkerCorrector(Json::Value config, ThreadPlacement placement) : m_running(false), m_busy(false) {
+		m_placement = placement;
+		m_trackableConfig = config["trackables"];
+		m_gain = config.get("gain", 0.2).asDouble();
+
+		double rate = config.get("rate", 5.0).asDouble();
+		m_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / (rate > 0 ? rate : 5.0)));
+
+		m_width = 0;
+		m_height = 0;
+		m_cameraParametersChanged = false;
+		osvrVec3Zero(&m_correction);
+		memset(&m_stats, 0, sizeof(m_stats));
+	}
+
+	MarkerCorrector::~MarkerCorrector() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_frameReady.notify_one();
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+	}
+
+	bool MarkerCorrector::init(KudanCameraParameters& cameraParameters, const std::string& licenseKey) {
+		try {
+			m_imageTracker.setApiKey(licenseKey);
+
+			// set global tracker properties:
+			m_imageTracker.setMaximumSimultaneousTracking(2);
+
+			// The tracker needs to know the intrinsics:
+			m_imageTracker.setCameraParameters(cameraParameters);
+
+			const Json::Value& trackables = m_trackableConfig;
+			for (Json::ArrayIndex i = 0; i < trackables.size(); i++) {
+				std::string image = trackables[i]["image"].asString();
+				std::shared_ptr<KudanImageTrackable> trackable = KudanImageTrackable::createFromImageFile(image);
+				if (!trackable || !m_imageTracker.addTrackable(trackable)) {
+					std::cout << "[TrackerKudan-OSVR] Could not load marker " << image << std::endl;
+					continue;
+				}
+
+				OSVR_Vec3 markerPosition;
+				osvrVec3Zero(&markerPosition);
+				osvrVec3SetX(&markerPosition, trackables[i]["position"]["x"].asDouble());
+				osvrVec3SetY(&markerPosition, trackables[i]["position"]["y"].asDouble());
+				osvrVec3SetZ(&markerPosition, trackables[i]["position"]["z"].asDouble());
+
+				m_trackables.push_back(trackable);
+				m_markerPositions.push_back(markerPosition);
+			}
+		}
+		catch (KudanException &e) {
+			printf("[TrackerKudan-OSVR] Marker tracker initialization failed. Caught exception: %s \n", e.what());
+			return false;
+		}
+
+		if (m_trackables.empty()) {
+			return false;
+		}
+
+		std::cout << "[TrackerKudan-OSVR] Marker drift correction running with " << m_trackables.size() << " marker(s)" << std::endl;
+		m_running = true;
+		m_thread = std::thread(&MarkerCorrector::markerLoop, this);
+		return true;
+	}
+
+	void MarkerCorrector::setCameraParameters(const KudanCameraParameters& cameraParameters) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cameraParameters = cameraParameters;
+		m_cameraParametersChanged = true;
+	}
+
+	void MarkerCorrector::submitFrame(const unsigned char* data, int width, int height, int stride,
+		const OSVR_PositionState& position, const OSVR_OrientationState& orientation) {
+		if (!m_running || m_busy) {
+			return;
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now < m_nextSubmit) {
+			return;
+		}
+		m_nextSubmit = now + m_period;
+
+		// The marker thread is idle, the buffer is ours until m_busy is set
+		m_frame.resize(static_cast<size_t>(width) * height);
+		for (int row = 0; row < height; row++) {
+			memcpy(&m_frame[static_cast<size_t>(row) * width], data + static_cast<size_t>(row) * stride, width);
+		}
+		m_width = width;
+		m_height = height;
+		m_framePosition = position;
+		m_frameOrientation = orientation;
+		m_submitTime = now;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busy = true;
+			m_stats.framesSubmitted++;
+		}
+		m_frameReady.notify_one();
+	}
+
+	void MarkerCorrector::correct(OSVR_PositionState* position) {
+		OSVR_Vec3 correction;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			correction = m_correction;
+		}
+		osvr::util::vecMap(*position) += osvr::util::vecMap(correction);
+	}
+
+	MarkerCorrectionStats MarkerCorrector::getStats() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	void MarkerCorrector::markerLoop() {
+		applyThreadPlacement(m_placement);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_frameReady.wait(lock, [this] { return !m_running || m_busy; });
+			if (!m_running) {
+				break;
+			}
+			bool cameraParametersChanged = m_cameraParametersChanged;
+			KudanCameraParameters cameraParameters = m_cameraParameters;
+			m_cameraParametersChanged = false;
+			lock.unlock();
+
+			if (cameraParametersChanged) {
+				try {
+					m_imageTracker.setCameraParameters(cameraParameters);
+				}
+				catch (KudanException &e) {
+					printf("[TrackerKudan-OSVR] Marker camera parameters change failed. Caught exception: %s \n", e.what());
+				}
+			}
+
+			m_imageTracker.processFrame(m_frame.data(), m_width, m_height, 1, 0 /*padding*/, false);
+			std::vector<std::shared_ptr<KudanImageTrackable> > detected = m_imageTracker.getDetectedTrackables();
+
+			// Head position given by each detected marker: marker world position minus the camera to marker
+			// vector rotated into the world. Same axes and scale as the Arbitrack position (see kudanToOsvr).
+			// Arbitrack is fed the sensed orientation, so its target stays in the axes it started in, while
+			// the marker pose is in the axes of the camera at this frame, hence the rotation here only.
+			Eigen::Quaterniond rotation = osvr::util::fromQuat(m_frameOrientation);
+			Eigen::Vector3d headPosition = Eigen::Vector3d::Zero();
+			int count = 0;
+			for (size_t i = 0; i < detected.size(); i++) {
+				for (size_t j = 0; j < m_trackables.size(); j++) {
+					if (detected[i] != m_trackables[j]) {
+						continue;
+					}
+					Eigen::Vector3d cameraToMarker = kudanToOsvr(detected[i]->getPosition());
+					headPosition += osvr::util::vecMap(m_markerPositions[j]) - rotation * cameraToMarker;
+					count++;
+				}
+			}
+
+			double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_submitTime).count();
+
+			MarkerCorrectionStats stats;
+			lock.lock();
+			if (count > 0) {
+				Eigen::Vector3d target = headPosition / count - osvr::util::vecMap(m_framePosition);
+				Eigen::Map<Eigen::Vector3d> correction = osvr::util::vecMap(m_correction);
+				correction += m_gain * (target - correction);
+
+				m_stats.detections++;
+				m_stats.lastCorrection = target.norm();
+				m_stats.maxCorrection = std::max(m_stats.maxCorrection, m_stats.lastCorrection);
+				m_stats.lastDetectionLatency = latency;
+				m_stats.meanDetectionLatency += (latency - m_stats.meanDetectionLatency) / m_stats.detections;
+			}
+			stats = m_stats;
+			m_busy = false;
+
+			if (count > 0 && stats.detections % 50 == 1) {
+				// Print without holding the lock, correct() takes it on every tracking update
+				lock.unlock();
+				std::cout << "[TrackerKudan-OSVR] Marker correction " << stats.lastCorrection << " m (max " << stats.maxCorrection
+					<< " m), detection latency " << stats.lastDetectionLatency << " ms (mean " << stats.meanDetectionLatency << " ms)" << std::endl;
+				lock.lock();
+			}
+		}
+	}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// include the Kudan Tracker Interface
+#include "KudanCV.h"
+
+#include "KudanAxes.h"
+#include "ThreadPlacement.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	struct MarkerCorrectionStats {
+		uint64_t framesSubmitted;
+		uint64_t detections;
+		double lastCorrection;			// m, distance between the marker and the Arbitrack position
+		double maxCorrection;			// m
+		double lastDetectionLatency;	// ms, from frame submission to marker pose
+		double meanDetectionLatency;	// ms
+	};
+
+	/// Runs a KudanImageTracker over the Arbitrack frames at a reduced rate on its own thread.
+	/// Each detected marker gives an absolute head position, the difference with Arbitrack
+	/// becomes an offset that re-anchors the Arbitrack position in the world frame of the markers.
+	///
+	/// Configured by the "markers" device param:
+	/// "markers": { "rate": 5, "gain": 0.2, "trackables": [ { "image": "marker.jpg", "position": { "x": 0, "y": 1.5, "z": -2 } } ] }
+	/// where "position" is the marker centre in the world frame, in metres.
+	class MarkerCorrector {
+	public:
+		MarkerCorrector(Json::Value config, ThreadPlacement placement);
+		~MarkerCorrector();
+
+		/// Sets up the image tracker and starts the marker thread. Returns false if no trackable could be loaded.
+		bool init(KudanCameraParameters& cameraParameters, const std::string& licenseKey);
+
+		/// Intrinsics of the next frames, after a resolution change. Applied by the marker thread before its next frame.
+		void setCameraParameters(const KudanCameraParameters& cameraParameters);
+
+		/// Called on the tracking thread with the frame Arbitrack just processed and the resulting position.
+		/// Copies the frame only when the marker thread is idle and due, and never waits for it.
+		void submitFrame(const unsigned char* data, int width, int height, int stride,
+			const OSVR_PositionState& position, const OSVR_OrientationState& orientation);
+
+		/// Adds the current drift correction to an Arbitrack position.
+		void correct(OSVR_PositionState* position);
+
+		MarkerCorrectionStats getStats();
+
+	private:
+		void markerLoop();
+
+		Json::Value m_trackableConfig;
+		KudanImageTracker m_imageTracker;
+		std::vector<std::shared_ptr<KudanImageTrackable> > m_trackables;
+		std::vector<OSVR_Vec3> m_markerPositions;
+
+		double m_gain;
+		std::chrono::steady_clock::duration m_period;
+		ThreadPlacement m_placement;
+
+		std::thread m_thread;
+		std::atomic<bool> m_running;
+		std::atomic<bool> m_busy;	// a frame is handed to the marker thread
+		std::mutex m_mutex;
+		std::condition_variable m_frameReady;
+
+		// Frame handed to the marker thread, owned by it while m_busy is set
+		std::vector<unsigned char> m_frame;
+		int m_width;
+		int m_height;
+		OSVR_PositionState m_framePosition;
+		OSVR_OrientationState m_frameOrientation;
+		std::chrono::steady_clock::time_point m_submitTime;
+		std::chrono::steady_clock::time_point m_nextSubmit;
+
+		// Intrinsics handed to the marker thread, under m_mutex
+		KudanCameraParameters m_cameraParameters;
+		bool m_cameraParametersChanged;
+
+		// Guarded by m_mutex
+		OSVR_Vec3 m_correction;
+		MarkerCorrectionStats m_stats;
+	};
+
+}
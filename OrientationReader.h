@@ -12,7 +12,7 @@ namespace com_samaust_trackerkudan_osvr {
 		static IOrientationReader* getReader(OSVR_ClientContext ctx, Json::Value config);
 	};
 
-	class SingleOrientationReader : public IOrientationReader {
+	class SingleOrientationReader final : public IOrientationReader {
 	public:
 		SingleOrientationReader(OSVR_ClientContext ctx, std::string orientation_path);
 		OSVR_ReturnCode update(OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue);
@@ -20,7 +20,7 @@ namespace com_samaust_trackerkudan_osvr {
 		OSVR_ClientInterface m_orientation;
 	};
 
-	class CombinedOrientationReader : public IOrientationReader {
+	class CombinedOrientationReader final : public IOrientationReader {
 	public:
 		CombinedOrientationReader(OSVR_ClientContext ctx, Json::Value orientation_paths);
 		OSVR_ReturnCode update(OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue);
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+
+#include "ParameterReloader.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace com_samaust_trackerkudan_osvr {
+
+	static const char* kTuningKeys[] = { "processingScale", "roi", "filter", "predictionHorizon", "offsetFromRotationCenter" };
+	static const int kTuningKeyCount = 5;
+
+	static bool isTuningKey(const std::string& key) {
+		for (int i = 0; i < kTuningKeyCount; i++) {
+			if (key == kTuningKeys[i]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	ParameterReloader::ParameterReloader(const FusionConfig& config, ThreadPlacement placement) {
+		m_deviceParams = config.json;
+		m_hasMarkers = config.hasMarkers;
+		m_file = config.reloadFile;
+		m_interval = config.reloadInterval;
+		m_parseMs = 0;
+		m_hasPending = false;
+
+		m_placement = placement;
+		m_stop = false;
+		m_thread = std::thread(&ParameterReloader::run, this);
+	}
+
+	ParameterReloader::~ParameterReloader() {
+		m_stop = true;
+		m_thread.join();
+	}
+
+	bool ParameterReloader::takePending(FusionParameters* parameters) {
+		if (!m_hasPending.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		double latencyMs;
+		double parseMs;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			*parameters = m_pending;
+			m_hasPending = false;
+			latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - m_changeSeen).count();
+			parseMs = m_parseMs;
+		}
+
+		std::cout << "[TrackerKudan-OSVR] Reloaded " << m_file << ": parsed in " << parseMs << " ms, applied "
+			<< latencyMs << " ms after the change was seen" << std::endl;
+		return true;
+	}
+
+	bool ParameterReloader::load(const std::string& text, FusionParameters* parameters, std::string* error) {
+		Json::Value file;
+		Json::Reader reader;
+		if (!reader.parse(text, file)) {
+			*error = reader.getFormattedErrorMessages();
+			return false;
+		}
+		if (!file.isObject()) {
+			*error = "the file must hold an object";
+			return false;
+		}
+
+		Json::Value merged = m_deviceParams;
+		std::vector<std::string> keys = file.getMemberNames();
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (isTuningKey(keys[i])) {
+				merged[keys[i]] = file[keys[i]];
+			}
+			else if (file[keys[i]] != m_deviceParams[keys[i]]) {
+				std::cout << "[TrackerKudan-OSVR] Reload: \"" << keys[i] << "\" needs a server restart, ignored" << std::endl;
+			}
+		}
+
+		if (!FusionParameters::validate(merged, error)) {
+			return false;
+		}
+		FusionParameters loaded = FusionParameters::fromConfig(merged);
+
+		// The marker tracker keeps the camera intrinsics of its startup resolution
+		FusionParameters startup = FusionParameters::fromConfig(m_deviceParams);
+		if (m_hasMarkers && loaded.processingScale != startup.processingScale) {
+			*error = "\"processingScale\" cannot change while markers are tracked";
+			return false;
+		}
+
+		*parameters = loaded;
+		return true;
+	}
+
+	void ParameterReloader::run() {
+		applyThreadPlacement(m_placement);
+
+		std::string lastText;
+		bool first = true;
+		while (!m_stop) {
+			bool forced = false;
+#ifdef _WIN32
+			// Reload now if CTRL + F11 is pressed, even without change
+			if ((GetAsyncKeyState(VK_CONTROL) & 0x8000) && (GetAsyncKeyState(VK_F11) & 0x8000)) {
+				forced = true;
+			}
+#endif
+
+			std::ifstream stream(m_file.c_str(), std::ios::binary);
+			if (stream) {
+				std::stringstream text;
+				text << stream.rdbuf();
+
+				if (first || forced || text.str() != lastText) {
+					Clock::time_point changeSeen = Clock::now();
+					lastText = text.str();
+					first = false;
+
+					FusionParameters parameters;
+					std::string error;
+					if (load(lastText, &parameters, &error)) {
+						std::lock_guard<std::mutex> lock(m_mutex);
+						m_pending = parameters;
+						m_changeSeen = changeSeen;
+						m_parseMs = std::chrono::duration<double, std::milli>(Clock::now() - changeSeen).count();
+						m_hasPending.store(true, std::memory_order_release);
+					}
+					else {
+						std::cout << "[TrackerKudan-OSVR] Reload of " << m_file << " rejected, parameters unchanged: " << error << std::endl;
+					}
+				}
+			}
+
+			// Short sleeps so that the destructor does not wait for a whole interval. The longer
+			// interval after a forced reload keeps a held CTRL + F11 from reloading at every poll.
+			Clock::time_point next = Clock::now() + std::chrono::milliseconds(forced && m_interval < 500 ? 500 : m_interval);
+			while (!m_stop && Clock::now() < next) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+	}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "FusionConfig.h"
+#include "ThreadPlacement.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Watches the "reload" file of a device and hands the fusion parameters it holds to the update
+	/// thread, which applies them between two frames. The file has the device params layout, its
+	/// tuning keys (processingScale, roi, filter, predictionHorizon, offsetFromRotationCenter)
+	/// override the device params. It is read at startup, whenever its content changes and, on Windows, on
+	/// CTRL + F11. An invalid file is reported and ignored, the device keeps its parameters.
+	class ParameterReloader {
+	public:
+		ParameterReloader(const FusionConfig& config, ThreadPlacement placement);
+		~ParameterReloader();
+
+		/// Update thread, between frames. True with the parameters to apply when a reload is pending.
+		bool takePending(FusionParameters* parameters);
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		void run();
+		bool load(const std::string& text, FusionParameters* parameters, std::string* error);
+
+		Json::Value m_deviceParams;
+		bool m_hasMarkers;
+		std::string m_file;
+		int m_interval;
+
+		std::mutex m_mutex;
+		FusionParameters m_pending;
+		Clock::time_point m_changeSeen;
+		double m_parseMs;
+		std::atomic<bool> m_hasPending;	// lets takePending skip the lock
+
+		ThreadPlacement m_placement;
+		std::atomic<bool> m_stop;
+		std::thread m_thread;
+	};
+
+}
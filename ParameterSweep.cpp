@@ -0,0 +1,634 @@
+// Replays recorded sessions (see "recordSession") through the fusion pipeline for every combination
+// of a parameter grid, in parallel, and ranks the combinations by pose error, jitter and frame cost.
+// Sessions recorded with depth start Arbitrack at the distance of the scene unless --no-depth is given.
+//
+// The grid uses the device params layout, with an array of candidates wherever a value is swept:
+// { "processingScale": [1, 0.75, 0.5], "roi": { "size": [1, 0.6] }, "filter": { "alpha": [1, 0.6], "beta": [0.5] },
+//   "predictionHorizon": [0, 0.01, 0.02], "offsetFromRotationCenter": [ { "x": 0, "y": 0.01, "z": -0.05 } ] }
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CameraClock.h"
+#include "FusionParameters.h"
+#include "FusionPipeline.h"
+#include "KudanPositionTracker.h"
+#include "SessionRecording.h"
+#include "WorkStealingPool.h"
+
+using namespace com_samaust_trackerkudan_osvr;
+
+namespace {
+
+	struct TimedPosition {
+		double time;
+		Eigen::Vector3d position;
+	};
+
+	// Tracked motion matching the reference motion within this for a whole window is stable
+	const double kSettleError = 0.02;	// m
+	const double kSettleWindow = 1.0;	// s
+
+	struct SessionMetrics {
+		SessionMetrics() : ok(false), hasError(false), hasSettled(false), rmsError(0), settleTime(0), jitter(0), frameCost(0), trackedArea(0), roiRestarts(0), frames(0) {}
+		bool ok;
+		bool hasError;
+		bool hasSettled;
+		double rmsError;	// m, against the reference after removing the mean offset
+		double settleTime;	// s from the first frame to a stable position, see settleTime()
+		double jitter;		// m, RMS of the second difference of the output positions
+		double frameCost;	// ms per frame spent in tracking
+		double trackedArea;	// mean fraction of the frames given to Arbitrack, below 1 with "roi"
+		unsigned int roiRestarts;	// Arbitrack restarts to change the window
+		size_t frames;
+	};
+
+	struct Candidate {
+		Json::Value params;
+		std::vector<SessionMetrics> sessions;
+		double rmsError;
+		double settleTime;
+		double jitter;
+		double frameCost;
+		double trackedArea;
+		double roiRestarts;
+		double score;	// infinity when unscored, no session had a reference
+		bool hasError;
+		bool hasSettled;
+	};
+
+	void usage() {
+		std::cout << "Usage: trackerkudan_sweep --grid <grid.json> [options] <session> [<session> ...]" << std::endl
+			<< "  --threads <n>             worker threads (default one per core)" << std::endl
+			<< "  --no-depth                ignore the depth of the sessions, Arbitrack starts at an assumed distance" << std::endl
+			<< "  --out <prefix>            report prefix (default sweep), writes <prefix>.csv, <prefix>.json and <prefix>_best.json" << std::endl
+			<< "  --weights <e> <j> <c>     score = e * error(m) + j * jitter(m) + c * cost(ms) (default 1 1 0.0005)" << std::endl;
+	}
+
+	/// Cartesian product of every array found in the grid.
+	void expandGrid(const Json::Value& grid, std::vector<Json::Value>& combinations) {
+		combinations.assign(1, Json::Value(Json::objectValue));
+
+		std::vector<std::pair<std::vector<std::string>, const Json::Value*> > pending;
+		pending.push_back(std::make_pair(std::vector<std::string>(), &grid));
+
+		while (!pending.empty()) {
+			std::vector<std::string> path = pending.back().first;
+			const Json::Value& node = *pending.back().second;
+			pending.pop_back();
+
+			if (node.isObject()) {
+				std::vector<std::string> names = node.getMemberNames();
+				for (size_t i = 0; i < names.size(); i++) {
+					std::vector<std::string> child = path;
+					child.push_back(names[i]);
+					pending.push_back(std::make_pair(child, &node[names[i]]));
+				}
+				continue;
+			}
+
+			Json::Value candidates = node;
+			if (!candidates.isArray()) {
+				candidates = Json::Value(Json::arrayValue);
+				candidates.append(node);
+			}
+
+			std::vector<Json::Value> expanded;
+			for (size_t c = 0; c < combinations.size(); c++) {
+				for (Json::ArrayIndex i = 0; i < candidates.size(); i++) {
+					Json::Value combination = combinations[c];
+					Json::Value* target = &combination;
+					for (size_t p = 0; p < path.size(); p++) {
+						target = &(*target)[path[p]];
+					}
+					*target = candidates[i];
+					expanded.push_back(combination);
+				}
+			}
+			combinations.swap(expanded);
+		}
+	}
+
+	bool interpolate(const std::vector<TimedPosition>& track, double time, Eigen::Vector3d& position) {
+		if (track.empty() || time < track.front().time || time > track.back().time) {
+			return false;
+		}
+		std::vector<TimedPosition>::const_iterator after = std::lower_bound(track.begin(), track.end(), time,
+			[](const TimedPosition& sample, double t) { return sample.time < t; });
+		if (after == track.begin()) {
+			position = after->position;
+			return true;
+		}
+		std::vector<TimedPosition>::const_iterator before = after - 1;
+		double span = after->time - before->time;
+		double w = span > 0 ? (time - before->time) / span : 0;
+		position = before->position + w * (after->position - before->position);
+		return true;
+	}
+
+	/// First output time after which the tracked motion follows the reference motion within kSettleError
+	/// for kSettleWindow, both taken from that time so that the offset between them does not matter.
+	bool settleTime(const std::vector<TimedPosition>& outputs, const std::vector<TimedPosition>& references, double* time) {
+		for (size_t start = 0; start < outputs.size(); start++) {
+			Eigen::Vector3d startReference;
+			if (!interpolate(references, outputs[start].time, startReference) || outputs.back().time - outputs[start].time < kSettleWindow) {
+				continue;
+			}
+			bool stable = true;
+			for (size_t i = start + 1; i < outputs.size() && outputs[i].time - outputs[start].time <= kSettleWindow && stable; i++) {
+				Eigen::Vector3d reference;
+				stable = interpolate(references, outputs[i].time, reference)
+					&& ((outputs[i].position - outputs[start].position) - (reference - startReference)).norm() < kSettleError;
+			}
+			if (stable) {
+				*time = outputs[start].time;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	OSVR_TimeValue toTimeValue(uint64_t us) {
+		OSVR_TimeValue time;
+		time.seconds = static_cast<int64_t>(us / 1000000);
+		time.microseconds = static_cast<int32_t>(us % 1000000);
+		return time;
+	}
+
+	double toSeconds(const OSVR_TimeValue& time) {
+		return time.seconds + time.microseconds / 1e6;
+	}
+
+	/// Sensed orientation recorded with the frame.
+	class ReplayOrientation {
+	public:
+		explicit ReplayOrientation(FusionContext&) : m_record(NULL) {}
+		void setRecord(const SessionRecord* record) { m_record = record; }
+		void update(OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+			*orientation = m_record->orientation();
+			*timeValue = toTimeValue(m_record->header.hostTimeUs);
+		}
+	private:
+		const SessionRecord* m_record;	// not owned
+	};
+
+	/// KudanPosition on the recorded frames: the tracker in the same configuration, one frame per update,
+	/// positions stamped with the capture time through the same CameraClock.
+	class ReplayPosition {
+	public:
+		explicit ReplayPosition(FusionContext& context)
+			: m_tracker(NULL, NULL, context.parameters.processingScale), m_cameraClock(context.config["cameraClock"]), m_record(NULL), m_useDepth(true),
+			m_initialized(false), m_tracked(false), m_cost(0), m_trackedArea(0), m_frames(0) {
+			m_tracker.requestRoi(context.parameters.roiSize, context.parameters.roiLookahead);
+		}
+
+		void setRecord(SessionRecord* record, bool useDepth) {
+			m_record = record;
+			m_useDepth = useDepth;
+		}
+
+		bool update(OSVR_PositionState* position, OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+			if (!m_initialized) {
+				m_tracker.init(cv::Size(m_record->header.width, m_record->header.height));
+				m_initialized = true;
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool tracked = m_tracker.processFrame(m_record->frameGrey(), *orientation, position, m_useDepth ? m_record->depthMap() : cv::Mat());
+			m_cost += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			m_trackedArea += m_tracker.trackedArea();
+			m_frames++;
+
+			FrameTime frameTime;
+			frameTime.valid = true;
+			frameTime.captureTimeUs = m_record->header.captureTimeUs;
+			frameTime.arrivalTime = toTimeValue(m_record->header.hostTimeUs);
+			OSVR_TimeValue captureTime = m_cameraClock.map(frameTime);
+
+			if (tracked) {
+				m_tracked = true;
+				m_time = captureTime;
+				*timeValue = m_time;
+			}
+			return tracked;
+		}
+
+		/// A position was tracked, the pipeline outputs follow it.
+		bool hasTracked() const { return m_tracked; }
+		/// Capture time of the last tracked position, on the OSVR clock.
+		const OSVR_TimeValue& time() const { return m_time; }
+
+		double cost() const { return m_cost; }
+		double trackedArea() const { return m_trackedArea; }
+		size_t frames() const { return m_frames; }
+		unsigned int roiRestarts() const { return m_tracker.roiRestarts(); }
+
+	private:
+		KudanPositionTracker m_tracker;
+		CameraClock m_cameraClock;
+		SessionRecord* m_record;	// not owned
+		bool m_useDepth;
+		bool m_initialized;
+		bool m_tracked;
+		OSVR_TimeValue m_time;
+		double m_cost;			// ms
+		double m_trackedArea;	// summed over the frames
+		size_t m_frames;
+	};
+
+	/// The poses are read back from the pipeline state.
+	class NoOutput {
+	public:
+		explicit NoOutput(FusionContext&) {}
+		void send(const OSVR_PoseState&, const OSVR_TimeValue&, const OSVR_TimeValue&) {}
+	};
+
+	/// The pipeline of TrackerKudanFusion in Kudan position mode, with the same filter and offset, driven by the recorded frames.
+	template <class Filter, class Offset>
+	SessionMetrics replaySession(const std::string& path, FusionContext& context, bool useDepth) {
+		SessionMetrics metrics;
+
+		SessionReader reader;
+		if (!reader.open(path)) {
+			return metrics;
+		}
+
+		FusionPipeline<ReplayOrientation, ReplayPosition, Filter, Offset, NoOutput> pipeline(context);
+		ReplayPosition& position = pipeline.positionSource();
+
+		std::vector<TimedPosition> outputs;
+		std::vector<TimedPosition> references;
+		double firstTime = 0;
+
+		SessionRecord record;
+		while (reader.next(&record)) {
+			double time = record.hostTime();
+			if (position.frames() == 0) {
+				firstTime = time;
+			}
+
+			pipeline.orientationSource().setRecord(&record);
+			position.setRecord(&record, useDepth);
+			pipeline.update();
+
+			if (record.header.hasReference) {
+				TimedPosition reference = { time, Eigen::Vector3d(record.header.reference[0], record.header.reference[1], record.header.reference[2]) };
+				references.push_back(reference);
+			}
+
+			// One output per tracked position, the updates in between repeat it
+			double outputTime = toSeconds(position.time()) + context.parameters.predictionHorizon;
+			if (!position.hasTracked() || (!outputs.empty() && outputs.back().time == outputTime)) {
+				continue;
+			}
+			TimedPosition output = { outputTime, osvr::util::vecMap(pipeline.state().translation) };
+			outputs.push_back(output);
+		}
+
+		metrics.frames = position.frames();
+		if (metrics.frames == 0) {
+			return metrics;
+		}
+		metrics.ok = true;
+		metrics.frameCost = position.cost() / metrics.frames;
+		metrics.trackedArea = position.trackedArea() / metrics.frames;
+		metrics.roiRestarts = position.roiRestarts();
+
+		double jitter = 0;
+		for (size_t i = 1; i + 1 < outputs.size(); i++) {
+			jitter += (outputs[i + 1].position - 2 * outputs[i].position + outputs[i - 1].position).squaredNorm();
+		}
+		if (outputs.size() > 2) {
+			metrics.jitter = std::sqrt(jitter / (outputs.size() - 2));
+		}
+
+		// Arbitrack has its own origin: compare after removing the mean offset to the reference
+		std::vector<Eigen::Vector3d> differences;
+		Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+		for (size_t i = 0; i < outputs.size(); i++) {
+			Eigen::Vector3d reference;
+			if (interpolate(references, outputs[i].time, reference)) {
+				differences.push_back(outputs[i].position - reference);
+				mean += differences.back();
+			}
+		}
+		if (!differences.empty()) {
+			mean /= static_cast<double>(differences.size());
+			double error = 0;
+			for (size_t i = 0; i < differences.size(); i++) {
+				error += (differences[i] - mean).squaredNorm();
+			}
+			metrics.rmsError = std::sqrt(error / differences.size());
+			metrics.hasError = true;
+		}
+
+		double settled;
+		if (settleTime(outputs, references, &settled)) {
+			metrics.settleTime = settled - firstTime;
+			metrics.hasSettled = true;
+		}
+
+		return metrics;
+	}
+
+	/// Filter and offset picked as TrackerKudanFusionConstructor does, there is no reload here.
+	template <class Filter>
+	SessionMetrics replayWithOffset(const std::string& path, FusionContext& context, bool useDepth) {
+		if (context.parameters.useOffset) {
+			return replaySession<Filter, RotationCenterOffset>(path, context, useDepth);
+		}
+		return replaySession<Filter, NoOffset>(path, context, useDepth);
+	}
+
+	SessionMetrics replaySession(const std::string& path, const Json::Value& params, bool useDepth) {
+		FusionContext context;
+		context.clientContext = NULL;
+		context.config = params;
+		context.parameters = FusionParameters::fromConfig(params);
+		context.timestamp = TIMESTAMP_POSITION;
+		context.device = NULL;
+		context.tracker = NULL;
+
+		if (context.parameters.filterAlpha == 1.0 && context.parameters.predictionHorizon == 0.0) {
+			return replayWithOffset<PassThroughFilter>(path, context, useDepth);
+		}
+		return replayWithOffset<SmoothingFilter>(path, context, useDepth);
+	}
+
+	std::string compact(const Json::Value& value) {
+		Json::FastWriter writer;
+		std::string text = writer.write(value);
+		text.erase(std::remove(text.begin(), text.end(), '\n'), text.end());
+		return text;
+	}
+
+}
+
+int main(int argc, char** argv) {
+	std::string gridPath;
+	std::string outPrefix = "sweep";
+	unsigned int threads = 0;
+	bool useDepth = true;
+	double errorWeight = 1;
+	double jitterWeight = 1;
+	double costWeight = 0.0005;
+	std::vector<std::string> sessions;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--grid" && i + 1 < argc) {
+			gridPath = argv[++i];
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			threads = std::atoi(argv[++i]);
+		}
+		else if (arg == "--no-depth") {
+			useDepth = false;
+		}
+		else if (arg == "--out" && i + 1 < argc) {
+			outPrefix = argv[++i];
+		}
+		else if (arg == "--weights" && i + 3 < argc) {
+			errorWeight = std::atof(argv[++i]);
+			jitterWeight = std::atof(argv[++i]);
+			costWeight = std::atof(argv[++i]);
+		}
+		else if (!arg.empty() && arg[0] != '-') {
+			sessions.push_back(arg);
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (gridPath.empty() || sessions.empty()) {
+		usage();
+		return 1;
+	}
+
+	Json::Value grid;
+	std::ifstream gridFile(gridPath.c_str());
+	Json::Reader reader;
+	if (!gridFile || !reader.parse(gridFile, grid) || !grid.isObject()) {
+		std::cerr << "[TrackerKudan-OSVR] Could not parse grid " << gridPath << std::endl;
+		return 1;
+	}
+
+	std::vector<Json::Value> expanded;
+	expandGrid(grid, expanded);
+
+	// The same checks as a parameter reload, a combination the device would refuse is not worth replaying
+	std::vector<Json::Value> combinations;
+	for (size_t c = 0; c < expanded.size(); c++) {
+		std::string error;
+		if (!FusionParameters::validate(expanded[c], &error) ||
+			(expanded[c].isMember("cameraClock") && !CameraClock::validate(expanded[c]["cameraClock"], &error))) {
+			std::cerr << "[TrackerKudan-OSVR] Skipping " << compact(expanded[c]) << ": " << error << std::endl;
+			continue;
+		}
+		combinations.push_back(expanded[c]);
+	}
+	if (combinations.empty()) {
+		std::cerr << "[TrackerKudan-OSVR] No valid combination in grid " << gridPath << std::endl;
+		return 1;
+	}
+
+	std::vector<Candidate> candidates(combinations.size());
+	for (size_t c = 0; c < combinations.size(); c++) {
+		candidates[c].params = combinations[c];
+		candidates[c].sessions.resize(sessions.size());
+	}
+
+	// One job per session x combination, results land in their own slot so no locking is needed
+	ThreadPlacement placement;
+	placement.name = "kudan-sweep";
+	WorkStealingPool pool(threads, placement);
+	std::cout << "[TrackerKudan-OSVR] " << combinations.size() << " combinations x " << sessions.size() << " sessions on "
+		<< pool.size() << " threads" << std::endl;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t c = 0; c < candidates.size(); c++) {
+		for (size_t s = 0; s < sessions.size(); s++) {
+			SessionMetrics* result = &candidates[c].sessions[s];
+			const Json::Value* params = &candidates[c].params;
+			const std::string* session = &sessions[s];
+			pool.submit([result, params, session, useDepth]() { *result = replaySession(*session, *params, useDepth); });
+		}
+	}
+	pool.wait();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (size_t c = 0; c < candidates.size(); c++) {
+		Candidate& candidate = candidates[c];
+		int ok = 0;
+		int withError = 0;
+		int settled = 0;
+		candidate.rmsError = 0;
+		candidate.settleTime = 0;
+		candidate.jitter = 0;
+		candidate.frameCost = 0;
+		candidate.trackedArea = 0;
+		candidate.roiRestarts = 0;
+		for (size_t s = 0; s < candidate.sessions.size(); s++) {
+			const SessionMetrics& metrics = candidate.sessions[s];
+			if (!metrics.ok) {
+				continue;
+			}
+			ok++;
+			candidate.jitter += metrics.jitter;
+			candidate.frameCost += metrics.frameCost;
+			candidate.trackedArea += metrics.trackedArea;
+			candidate.roiRestarts += metrics.roiRestarts;
+			if (metrics.hasError) {
+				withError++;
+				candidate.rmsError += metrics.rmsError;
+			}
+			if (metrics.hasSettled) {
+				settled++;
+				candidate.settleTime += metrics.settleTime;
+			}
+		}
+		candidate.hasError = withError > 0;
+		candidate.hasSettled = settled > 0;
+		candidate.score = std::numeric_limits<double>::infinity();
+		if (ok == 0) {
+			continue;
+		}
+		candidate.jitter /= ok;
+		candidate.frameCost /= ok;
+		candidate.trackedArea /= ok;
+		candidate.roiRestarts /= ok;
+		if (settled > 0) {
+			candidate.settleTime /= settled;
+		}
+		if (withError == 0) {
+			continue;
+		}
+		candidate.rmsError /= withError;
+
+		// Scored on the sessions with a reference only, the others have no error to weigh the jitter and cost against
+		double jitter = 0;
+		double frameCost = 0;
+		for (size_t s = 0; s < candidate.sessions.size(); s++) {
+			const SessionMetrics& metrics = candidate.sessions[s];
+			if (metrics.ok && metrics.hasError) {
+				jitter += metrics.jitter;
+				frameCost += metrics.frameCost;
+			}
+		}
+		candidate.score = errorWeight * candidate.rmsError + (jitterWeight * jitter + costWeight * frameCost) / withError;
+	}
+
+	for (size_t s = 0; s < sessions.size(); s++) {
+		bool hasError = false;
+		for (size_t c = 0; c < candidates.size() && !hasError; c++) {
+			hasError = candidates[c].sessions[s].hasError;
+		}
+		if (!hasError) {
+			std::cout << "[TrackerKudan-OSVR] " << sessions[s] << " has no reference positions along the tracked ones, not scored" << std::endl;
+		}
+	}
+
+	std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.score < b.score; });
+
+	std::ofstream csv((outPrefix + ".csv").c_str());
+	csv << "rank,score,rms_error_m,settle_time_s,jitter_m,frame_cost_ms,tracked_area,roi_restarts,params" << std::endl;
+	Json::Value report(Json::arrayValue);
+	for (size_t c = 0; c < candidates.size(); c++) {
+		const Candidate& candidate = candidates[c];
+		std::string params = compact(candidate.params);
+		std::string quoted;
+		for (size_t i = 0; i < params.size(); i++) {
+			quoted += params[i] == '"' ? std::string("\"\"") : std::string(1, params[i]);
+		}
+		csv << c + 1 << "," << (candidate.hasError ? candidate.score : std::nan("")) << "," << (candidate.hasError ? candidate.rmsError : std::nan(""))
+			<< "," << (candidate.hasSettled ? candidate.settleTime : std::nan("")) << "," << candidate.jitter << "," << candidate.frameCost << "," << candidate.trackedArea << "," << candidate.roiRestarts << ",\"" << quoted << "\"" << std::endl;
+
+		Json::Value entry;
+		entry["rank"] = static_cast<Json::UInt>(c + 1);
+		if (candidate.hasError) {
+			entry["score"] = candidate.score;
+			entry["rmsError"] = candidate.rmsError;
+		}
+		if (candidate.hasSettled) {
+			entry["settleTime"] = candidate.settleTime;
+		}
+		entry["jitter"] = candidate.jitter;
+		entry["frameCost"] = candidate.frameCost;
+		entry["trackedArea"] = candidate.trackedArea;
+		entry["roiRestarts"] = candidate.roiRestarts;
+		entry["params"] = candidate.params;
+		report.append(entry);
+	}
+	std::ofstream json((outPrefix + ".json").c_str());
+	json << report.toStyledString();
+
+	std::cout << "[TrackerKudan-OSVR] Swept in " << std::fixed << std::setprecision(1) << elapsed << " s" << std::endl;
+	std::cout << std::setprecision(5);
+	for (size_t c = 0; c < candidates.size() && c < 10; c++) {
+		std::cout << std::setw(3) << c + 1;
+		if (candidates[c].hasError) {
+			std::cout << "  score " << candidates[c].score << "  error " << candidates[c].rmsError << " m";
+		}
+		else {
+			std::cout << "  unscored";
+		}
+		std::cout << "  settle " << candidates[c].settleTime << " s  jitter " << candidates[c].jitter << " m  cost " << candidates[c].frameCost << " ms  area " << candidates[c].trackedArea << "  "
+			<< compact(candidates[c].params) << std::endl;
+	}
+
+	// Windows against full frames with otherwise the same parameters, when the grid has both
+	bool roiHeader = false;
+	for (size_t c = 0; c < candidates.size(); c++) {
+		const Candidate& windowed = candidates[c];
+		if (!windowed.hasError || FusionParameters::fromConfig(windowed.params).roiSize >= 1) {
+			continue;
+		}
+		std::string params = compact(windowed.params);
+		for (size_t f = 0; f < candidates.size(); f++) {
+			if (!candidates[f].hasError || FusionParameters::fromConfig(candidates[f].params).roiSize < 1) {
+				continue;
+			}
+			Json::Value same = candidates[f].params;
+			same["roi"]["size"] = windowed.params["roi"]["size"];
+			if (compact(same) != params) {
+				continue;
+			}
+			if (!roiHeader) {
+				std::cout << std::endl << "ROI against full frames:" << std::endl;
+				roiHeader = true;
+			}
+			std::cout << "  area " << windowed.trackedArea << "  restarts " << windowed.roiRestarts << "  error " << windowed.rmsError << " m against " << candidates[f].rmsError
+				<< " m  cost " << windowed.frameCost << " ms against " << candidates[f].frameCost << " ms  " << params << std::endl;
+		}
+	}
+
+	if (!candidates[0].hasError) {
+		std::cout << std::endl << "[TrackerKudan-OSVR] No session has a reference position (\"recordReference\"), nothing to rank, no "
+			<< outPrefix << "_best.json written" << std::endl;
+	}
+	else {
+		// Normalised through FusionParameters so that the snippet holds every tunable key
+		Json::Value best = FusionParameters::fromConfig(candidates[0].params).toConfig();
+		if (candidates[0].params.isMember("cameraClock")) {
+			best["cameraClock"] = candidates[0].params["cameraClock"];
+		}
+		std::ofstream snippet((outPrefix + "_best.json").c_str());
+		snippet << best.toStyledString();
+		std::cout << std::endl << "Best parameters, to paste into the device params of osvr_server_config.json:" << std::endl
+			<< best.toStyledString();
+	}
+
+	return 0;
+}
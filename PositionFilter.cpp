@@ -0,0 +1,49 @@
+#include "stdafx.h"
+
+#include "PositionFilter.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	PositionFilter::PositionFilter(double alpha, double beta, double predictionHorizon) {
+		setParameters(alpha, beta, predictionHorizon);
+		m_initialized = false;
+		m_lastTime = 0;
+		m_position.setZero();
+		m_velocity.setZero();
+	}
+
+	void PositionFilter::setParameters(double alpha, double beta, double predictionHorizon) {
+		m_alpha = alpha;
+		m_beta = beta;
+		m_predictionHorizon = predictionHorizon;
+	}
+
+	void PositionFilter::addMeasurement(const OSVR_PositionState& position, double time) {
+		Eigen::Vector3d measured = osvr::util::vecMap(position);
+
+		if (!m_initialized) {
+			m_position = measured;
+			m_velocity.setZero();
+			m_lastTime = time;
+			m_initialized = true;
+			return;
+		}
+
+		double dt = time - m_lastTime;
+		if (dt <= 0) {
+			// Same timestamp twice: only refresh the level
+			m_position += m_alpha * (measured - m_position);
+			return;
+		}
+
+		Eigen::Vector3d previous = m_position;
+		m_position = m_alpha * measured + (1 - m_alpha) * (m_position + m_velocity * dt);
+		m_velocity = m_beta * (m_position - previous) / dt + (1 - m_beta) * m_velocity;
+		m_lastTime = time;
+	}
+
+	void PositionFilter::predict(OSVR_PositionState* position) const {
+		osvr::util::vecMap(*position) = m_position + m_velocity * m_predictionHorizon;
+	}
+
+}
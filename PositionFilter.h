@@ -0,0 +1,34 @@
+#pragma once
+#include "stdafx.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Double exponential smoothing of the tracked position with constant velocity prediction.
+	/// alpha weights new positions (1 passes them through), beta weights new velocities, and the
+	/// output is extrapolated predictionHorizon seconds past the last measurement.
+	class PositionFilter {
+	public:
+		PositionFilter(double alpha, double beta, double predictionHorizon);
+
+		void setParameters(double alpha, double beta, double predictionHorizon);
+
+		/// Adds a position measured at time (s).
+		void addMeasurement(const OSVR_PositionState& position, double time);
+
+		bool hasMeasurement() const { return m_initialized; }
+
+		/// Filtered position, predicted predictionHorizon seconds ahead of the last measurement.
+		void predict(OSVR_PositionState* position) const;
+
+	private:
+		double m_alpha;
+		double m_beta;
+		double m_predictionHorizon;
+
+		bool m_initialized;
+		double m_lastTime;
+		Eigen::Vector3d m_position;
+		Eigen::Vector3d m_velocity;
+	};
+
+}
@@ -12,7 +12,7 @@ namespace com_samaust_trackerkudan_osvr {
 		static IPositionReader* getReader(OSVR_ClientContext ctx, Json::Value config);
 	};
 
-	class SinglePositionReader : public IPositionReader {
+	class SinglePositionReader final : public IPositionReader {
 	public:
 		SinglePositionReader(OSVR_ClientContext ctx, std::string position_path);
 		OSVR_ReturnCode update(OSVR_PositionState* position, OSVR_TimeValue* timeValue);
@@ -20,7 +20,7 @@ namespace com_samaust_trackerkudan_osvr {
 		OSVR_ClientInterface m_position;
 	};
 
-	class CombinedPositionReader : public IPositionReader {
+	class CombinedPositionReader final : public IPositionReader {
 	public:
 		CombinedPositionReader(OSVR_ClientContext ctx, Json::Value position_paths);
 		OSVR_ReturnCode update(OSVR_PositionState* position, OSVR_TimeValue* timeValue);
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+
+#include "RoiSelector.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	// Margin added around the window on each side, as a fraction of the frame
+	static const double kSlack = 0.05;
+	// Keeps the window start aligned in memory for the SIMD code of the tracker
+	static const int kGrid = 16;
+
+	static int alignDown(int value) {
+		return value / kGrid * kGrid;
+	}
+
+	static int alignUp(int value) {
+		return (value + kGrid - 1) / kGrid * kGrid;
+	}
+
+	RoiSelector::RoiSelector() {
+		m_size = 1;
+		m_lookahead = 4;
+		m_hasOrientation = false;
+		m_rotationX = 0;
+		m_rotationY = 0;
+	}
+
+	void RoiSelector::setParameters(double size, double lookahead) {
+		m_size = size;
+		m_lookahead = lookahead;
+	}
+
+	void RoiSelector::update(const OSVR_OrientationState& orientation) {
+		if (m_hasOrientation) {
+			Eigen::Quaterniond last(m_lastOrientation.data[0], m_lastOrientation.data[1], m_lastOrientation.data[2], m_lastOrientation.data[3]);
+			Eigen::Quaterniond current(orientation.data[0], orientation.data[1], orientation.data[2], orientation.data[3]);
+			Eigen::Quaterniond delta = last.conjugate() * current;
+			if (delta.w() < 0) {
+				delta.coeffs() *= -1;
+			}
+			m_rotationX = 2 * delta.x();
+			m_rotationY = 2 * delta.y();
+		}
+		m_lastOrientation = orientation;
+		m_hasOrientation = true;
+	}
+
+	bool RoiSelector::wanted(cv::Size frameSize, double focal, cv::Rect* rect) const {
+		if (m_size >= 1) {
+			return false;
+		}
+
+		// Image motion of the scene per frame: turning left (+y) moves the scene right, looking up (+x) moves it down
+		double motionX = focal * m_rotationY;
+		double motionY = focal * m_rotationX;
+
+		// The window covers where the tracked features are and where they will be
+		double width = m_size * frameSize.width + m_lookahead * fabs(motionX);
+		double height = m_size * frameSize.height + m_lookahead * fabs(motionY);
+		if (width >= frameSize.width && height >= frameSize.height) {
+			return false;
+		}
+		double centerX = frameSize.width / 2.0 + m_lookahead * motionX / 2;
+		double centerY = frameSize.height / 2.0 + m_lookahead * motionY / 2;
+
+		*rect = cv::Rect(static_cast<int>(centerX - width / 2), static_cast<int>(centerY - height / 2),
+			static_cast<int>(ceil(width)), static_cast<int>(ceil(height))) & cv::Rect(cv::Point(0, 0), frameSize);
+		return true;
+	}
+
+	cv::Rect RoiSelector::select(cv::Size frameSize, double focal, bool confident) const {
+		cv::Rect full(cv::Point(0, 0), frameSize);
+		cv::Rect wanted;
+		if (!confident || !this->wanted(frameSize, focal, &wanted)) {
+			return full;
+		}
+
+		int slackX = static_cast<int>(kSlack * frameSize.width);
+		int slackY = static_cast<int>(kSlack * frameSize.height);
+		int left = alignDown(wanted.x - slackX > 0 ? wanted.x - slackX : 0);
+		int top = wanted.y - slackY > 0 ? wanted.y - slackY : 0;
+		int right = alignUp(wanted.br().x + slackX);
+		int bottom = wanted.br().y + slackY;
+		return cv::Rect(left, top, right - left, bottom - top) & full;
+	}
+
+	bool RoiSelector::fits(const cv::Rect& window, cv::Size frameSize, double focal) const {
+		cv::Rect wanted;
+		return this->wanted(frameSize, focal, &wanted) && (window & wanted) == wanted;
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "stdafx.h"
+
+// OpenCV is required for the window
+#include <opencv2/core/core.hpp>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Picks the part of the frame Arbitrack tracks. A window change needs new intrinsics and so a
+	/// restart of Arbitrack, which costs tracking quality, so the tracker keeps a window as long as
+	/// it fits and only restarts to change it, see KudanPositionTracker::followRoi.
+	/// With little head motion a centred window of "size" times the frame is enough. It grows and
+	/// moves along the image motion the sensed rotation predicts for the next "lookahead" frames, and
+	/// is the full frame when the motion is too fast or the tracking lost confidence. Windows are
+	/// snapped to a 16 pixel grid.
+	class RoiSelector {
+	public:
+		RoiSelector();
+
+		/// size in ]0, 1], 1 tracks full frames. lookahead in frames. Applies from the next window.
+		void setParameters(double size, double lookahead);
+
+		/// Every frame, follows the head rotation.
+		void update(const OSVR_OrientationState& orientation);
+
+		/// Window for Arbitrack starting on this frame of frameSize. focal is in pixels of that frame.
+		cv::Rect select(cv::Size frameSize, double focal, bool confident) const;
+
+		/// window still covers the part of the frame the predicted motion needs, false when full frames are needed.
+		bool fits(const cv::Rect& window, cv::Size frameSize, double focal) const;
+
+	private:
+		/// Part of the frame needed for the next "lookahead" frames, before slack. False for the full frame.
+		bool wanted(cv::Size frameSize, double focal, cv::Rect* rect) const;
+
+		double m_size;
+		double m_lookahead;
+
+		bool m_hasOrientation;
+		OSVR_OrientationState m_lastOrientation;
+		// Rotation since the previous frame, in radians about the camera x (looking up) and y (turning left) axes
+		double m_rotationX;
+		double m_rotationY;
+	};
+
+}
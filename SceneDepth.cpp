@@ -0,0 +1,110 @@
+#include "stdafx.h"
+
+#include <algorithm>
+
+#include "SceneDepth.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	// Every 4th pixel of every 4th row is enough for a median
+	static const int kStep = 4;
+	// Part of the window that must have a depth
+	static const double kMinValid = 0.3;
+
+	// Frames between two scale checks
+	static const unsigned int kCheckFrames = 10;
+	// Checks combined, through their median, before deciding
+	static const size_t kChecks = 3;
+	// Centre of the frame measured, the target is near the optical axis
+	static const double kCheckWindow = 0.2;
+	// Head rotation from the start orientation still checked, radians (about 5 degrees)
+	static const double kMaxRotation = 0.09;
+	// Scale error corrected, below it the scale is confirmed
+	static const double kTolerance = 0.1;
+
+	bool dominantDepth(const cv::Mat& depth, double fraction, double* distance) {
+		if (depth.empty() || depth.type() != CV_16UC1) {
+			return false;
+		}
+		int width = static_cast<int>(depth.cols * fraction);
+		int height = static_cast<int>(depth.rows * fraction);
+		int left = (depth.cols - width) / 2;
+		int top = (depth.rows - height) / 2;
+
+		std::vector<uint16_t> values;
+		values.reserve(static_cast<size_t>(width / kStep + 1) * (height / kStep + 1));
+		size_t samples = 0;
+		for (int row = top; row < top + height; row += kStep) {
+			const uint16_t* line = depth.ptr<uint16_t>(row);
+			for (int col = left; col < left + width; col += kStep) {
+				samples++;
+				if (line[col] > 0) {
+					values.push_back(line[col]);
+				}
+			}
+		}
+		if (samples == 0 || values.size() < kMinValid * samples) {
+			return false;
+		}
+
+		std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+		*distance = values[values.size() / 2] / 1000.0;
+		return true;
+	}
+
+	DepthScaleMonitor::DepthScaleMonitor() {
+		osvrQuatSetIdentity(&m_startOrientation);
+		m_frames = 0;
+		m_confirmed = false;
+	}
+
+	void DepthScaleMonitor::restart(const OSVR_OrientationState& orientation) {
+		m_startOrientation = orientation;
+		m_frames = 0;
+		m_ratios.clear();
+		m_confirmed = false;
+	}
+
+	bool DepthScaleMonitor::due() const {
+		return (m_frames + 1) % kCheckFrames == 0;
+	}
+
+	bool DepthScaleMonitor::check(const cv::Mat& depth, const OSVR_OrientationState& orientation, double trackedDistance, double* correction) {
+		if (++m_frames % kCheckFrames != 0 || depth.empty() || trackedDistance <= 0) {
+			return false;
+		}
+
+		// Looking elsewhere, the depth in the centre is not the distance to the target
+		double dot = fabs(osvrQuatGetW(&orientation) * osvrQuatGetW(&m_startOrientation)
+			+ osvrQuatGetX(&orientation) * osvrQuatGetX(&m_startOrientation)
+			+ osvrQuatGetY(&orientation) * osvrQuatGetY(&m_startOrientation)
+			+ osvrQuatGetZ(&orientation) * osvrQuatGetZ(&m_startOrientation));
+		if (2 * acos(dot < 1 ? dot : 1) > kMaxRotation) {
+			return false;
+		}
+
+		double measured;
+		if (!dominantDepth(depth, kCheckWindow, &measured)) {
+			return false;
+		}
+		m_ratios.push_back(measured / trackedDistance);
+		if (m_ratios.size() < kChecks) {
+			return false;
+		}
+
+		std::vector<double> sorted(m_ratios);
+		std::sort(sorted.begin(), sorted.end());
+		double ratio = sorted[sorted.size() / 2];
+		m_ratios.erase(m_ratios.begin());
+
+		if (fabs(ratio - 1) <= kTolerance) {
+			m_confirmed = true;
+			return false;
+		}
+		*correction = ratio;
+		m_ratios.clear();
+		m_confirmed = false;
+		return true;
+	}
+
+}
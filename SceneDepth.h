@@ -0,0 +1,44 @@
+#pragma once
+#include "stdafx.h"
+
+#include <vector>
+
+// OpenCV is required for the depth images
+#include <opencv2/core/core.hpp>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	// Depth images are CV_16UC1 in millimetres, aligned to the tracked frames, 0 where unknown
+
+	/// Median depth, in metres, of a centred window of "fraction" of the image width and height.
+	/// False when too few of its pixels have a depth.
+	bool dominantDepth(const cv::Mat& depth, double fraction, double* distance);
+
+	/// Checks the scale of Arbitrack against the depth while the head looks where it did when
+	/// Arbitrack started, then the distance to the tracked target is the distance to the scene.
+	class DepthScaleMonitor {
+	public:
+		DepthScaleMonitor();
+
+		/// Arbitrack started, the target is in front of the camera at this orientation.
+		void restart(const OSVR_OrientationState& orientation);
+
+		/// Call every frame, with or without depth, checks every few frames. trackedDistance is the distance to the
+		/// target in metres as Arbitrack tracks it. True when the positions need to be scaled
+		/// by *correction.
+		bool check(const cv::Mat& depth, const OSVR_OrientationState& orientation, double trackedDistance, double* correction);
+
+		/// The next frame is checked, sources may skip the depth of the others.
+		bool due() const;
+
+		/// The last checks agreed with the tracked scale.
+		bool confirmed() const { return m_confirmed; }
+
+	private:
+		OSVR_OrientationState m_startOrientation;
+		unsigned int m_frames;
+		std::vector<double> m_ratios;	// measured over tracked distance, of the last checks
+		bool m_confirmed;
+	};
+
+}
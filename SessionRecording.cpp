@@ -0,0 +1,185 @@
+#include "stdafx.h"
+#include <cstring>
+#include <iostream>
+
+#include "SessionRecording.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	static const char kSessionMagic[6] = { 'K', 'D', 'S', 'E', 'S', 'S' };
+	static const uint16_t kSessionVersion = 2;
+	static const size_t kMaxQueuedRecords = 8;
+
+	OSVR_OrientationState SessionRecord::orientation() const {
+		OSVR_OrientationState orientation;
+		osvrQuatSetW(&orientation, header.orientation[0]);
+		osvrQuatSetX(&orientation, header.orientation[1]);
+		osvrQuatSetY(&orientation, header.orientation[2]);
+		osvrQuatSetZ(&orientation, header.orientation[3]);
+		return orientation;
+	}
+
+	SessionRecorder::SessionRecorder(std::string path, ThreadPlacement placement) {
+		m_placement = placement;
+		m_running = false;
+		m_hasReference = false;
+		m_droppedFrames = 0;
+		osvrVec3Zero(&m_reference);
+
+		m_file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+		if (!m_file.is_open()) {
+			std::cout << "[TrackerKudan-OSVR] Could not create session file " << path << std::endl;
+			return;
+		}
+		m_file.write(kSessionMagic, sizeof(kSessionMagic));
+		m_file.write(reinterpret_cast<const char*>(&kSessionVersion), sizeof(kSessionVersion));
+
+		std::cout << "[TrackerKudan-OSVR] Recording session to " << path << std::endl;
+		m_running = true;
+		m_thread = std::thread(&SessionRecorder::recorderLoop, this);
+	}
+
+	SessionRecorder::~SessionRecorder() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_recordReady.notify_one();
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+		if (m_droppedFrames > 0) {
+			std::cout << "[TrackerKudan-OSVR] Session recording dropped " << m_droppedFrames << " frames" << std::endl;
+		}
+	}
+
+	void SessionRecorder::setReference(const OSVR_PositionState& position) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_reference = position;
+		m_hasReference = true;
+	}
+
+	void SessionRecorder::recordFrame(const cv::Mat& frameGrey, const OSVR_OrientationState& orientation, uint64_t captureTimeUs, const cv::Mat& depth) {
+		OSVR_TimeValue now;
+		osvrTimeValueGetNow(&now);
+
+		SessionRecord record;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_running || m_queue.size() >= kMaxQueuedRecords) {
+				m_droppedFrames++;
+				return;
+			}
+			// Reuse the buffers of records already written
+			if (!m_freeRecords.empty()) {
+				record.frame.swap(m_freeRecords.back().frame);
+				record.depth.swap(m_freeRecords.back().depth);
+				m_freeRecords.pop_back();
+			}
+			record.header.hasReference = m_hasReference ? 1 : 0;
+			record.header.reference[0] = osvrVec3GetX(&m_reference);
+			record.header.reference[1] = osvrVec3GetY(&m_reference);
+			record.header.reference[2] = osvrVec3GetZ(&m_reference);
+		}
+
+		record.header.hostTimeUs = static_cast<uint64_t>(now.seconds) * 1000000 + now.microseconds;
+		record.header.captureTimeUs = captureTimeUs;
+		record.header.orientation[0] = osvrQuatGetW(&orientation);
+		record.header.orientation[1] = osvrQuatGetX(&orientation);
+		record.header.orientation[2] = osvrQuatGetY(&orientation);
+		record.header.orientation[3] = osvrQuatGetZ(&orientation);
+		record.header.width = frameGrey.cols;
+		record.header.height = frameGrey.rows;
+		record.header.hasDepth = depth.size() == frameGrey.size() && depth.type() == CV_16UC1 ? 1 : 0;
+
+		record.frame.resize(static_cast<size_t>(frameGrey.cols) * frameGrey.rows);
+		for (int row = 0; row < frameGrey.rows; row++) {
+			memcpy(&record.frame[static_cast<size_t>(row) * frameGrey.cols], frameGrey.ptr(row), frameGrey.cols);
+		}
+		record.depth.resize(record.header.hasDepth ? record.frame.size() : 0);
+		for (int row = 0; row < depth.rows && record.header.hasDepth; row++) {
+			memcpy(&record.depth[static_cast<size_t>(row) * depth.cols], depth.ptr(row), depth.cols * sizeof(uint16_t));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(SessionRecord());
+			m_queue.back().header = record.header;
+			m_queue.back().frame.swap(record.frame);
+			m_queue.back().depth.swap(record.depth);
+		}
+		m_recordReady.notify_one();
+	}
+
+	uint64_t SessionRecorder::droppedFrames() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_droppedFrames;
+	}
+
+	void SessionRecorder::recorderLoop() {
+		applyThreadPlacement(m_placement);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_recordReady.wait(lock, [this] { return !m_running || !m_queue.empty(); });
+			if (m_queue.empty()) {
+				break;
+			}
+
+			SessionRecord record;
+			record.header = m_queue.front().header;
+			record.frame.swap(m_queue.front().frame);
+			record.depth.swap(m_queue.front().depth);
+			m_queue.pop_front();
+			lock.unlock();
+
+			m_file.write(reinterpret_cast<const char*>(&record.header), sizeof(record.header));
+			m_file.write(reinterpret_cast<const char*>(record.frame.data()), record.frame.size());
+			m_file.write(reinterpret_cast<const char*>(record.depth.data()), record.depth.size() * sizeof(uint16_t));
+
+			lock.lock();
+			m_freeRecords.push_back(SessionRecord());
+			m_freeRecords.back().frame.swap(record.frame);
+			m_freeRecords.back().depth.swap(record.depth);
+		}
+		m_file.flush();
+	}
+
+	bool SessionReader::open(const std::string& path) {
+		m_file.open(path.c_str(), std::ios::binary);
+		if (!m_file.is_open()) {
+			std::cout << "[TrackerKudan-OSVR] Could not open session file " << path << std::endl;
+			return false;
+		}
+
+		char magic[sizeof(kSessionMagic)];
+		uint16_t version = 0;
+		m_file.read(magic, sizeof(magic));
+		m_file.read(reinterpret_cast<char*>(&version), sizeof(version));
+		if (!m_file || memcmp(magic, kSessionMagic, sizeof(magic)) != 0 || version < 1 || version > kSessionVersion) {
+			std::cout << "[TrackerKudan-OSVR] " << path << " is not a session file" << std::endl;
+			m_file.close();
+			return false;
+		}
+
+		m_firstRecord = m_file.tellg();
+		return true;
+	}
+
+	bool SessionReader::next(SessionRecord* record) {
+		if (!m_file.read(reinterpret_cast<char*>(&record->header), sizeof(record->header))) {
+			return false;
+		}
+		record->frame.resize(static_cast<size_t>(record->header.width) * record->header.height);
+		record->depth.resize(record->header.hasDepth ? record->frame.size() : 0);
+		m_file.read(reinterpret_cast<char*>(record->frame.data()), record->frame.size());
+		m_file.read(reinterpret_cast<char*>(record->depth.data()), record->depth.size() * sizeof(uint16_t));
+		return static_cast<bool>(m_file);
+	}
+
+	void SessionReader::rewind() {
+		m_file.clear();
+		m_file.seekg(m_firstRecord);
+	}
+
+}
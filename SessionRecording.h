@@ -0,0 +1,91 @@
+#pragma once
+#include "stdafx.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// OpenCV is required for the frame buffers
+#include <opencv2/core/core.hpp>
+
+#include "ThreadPlacement.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// A session file starts with "KDSESS" and a version, followed by records, each a
+	/// SessionRecordHeader and width * height bytes of tightly packed greyscale pixels.
+	/// Since version 2, records with hasDepth are followed by width * height 16 bit depths in
+	/// millimetres, aligned to the frame. Version 1 files read as sessions without depth.
+	struct SessionRecordHeader {
+		uint64_t hostTimeUs;		// OSVR clock when the frame reached the tracker
+		uint64_t captureTimeUs;		// frame source clock, 0 if unknown
+		double orientation[4];		// w, x, y, z sensed orientation given to Arbitrack
+		double reference[3];		// reference position (m), when hasReference is set
+		uint32_t hasReference;
+		uint32_t width;
+		uint32_t height;
+		uint32_t hasDepth;			// 0 in version 1
+	};
+
+	struct SessionRecord {
+		SessionRecordHeader header;
+		std::vector<unsigned char> frame;
+		std::vector<uint16_t> depth;
+
+		cv::Mat frameGrey() { return cv::Mat(header.height, header.width, CV_8UC1, frame.data()); }
+		/// Empty without depth, see SceneDepth.h.
+		cv::Mat depthMap() { return header.hasDepth ? cv::Mat(header.height, header.width, CV_16UC1, depth.data()) : cv::Mat(); }
+		OSVR_OrientationState orientation() const;
+		double hostTime() const { return header.hostTimeUs / 1e6; }
+	};
+
+	/// Writes the greyscale frames seen by the tracker, with the sensed orientation and an optional
+	/// reference position, on a background recorder thread. Frames are dropped when the disk lags.
+	class SessionRecorder {
+	public:
+		SessionRecorder(std::string path, ThreadPlacement placement);
+		~SessionRecorder();
+
+		bool isOpen() const { return m_file.is_open(); }
+
+		/// Latest reference position, stored with the next recorded frames.
+		void setReference(const OSVR_PositionState& position);
+		/// depth, optional, is aligned to the frame, see SceneDepth.h.
+		void recordFrame(const cv::Mat& frameGrey, const OSVR_OrientationState& orientation, uint64_t captureTimeUs, const cv::Mat& depth = cv::Mat());
+
+		uint64_t droppedFrames();
+
+	private:
+		void recorderLoop();
+
+		std::ofstream m_file;
+		ThreadPlacement m_placement;
+		std::thread m_thread;
+		bool m_running;
+
+		std::mutex m_mutex;
+		std::condition_variable m_recordReady;
+		std::deque<SessionRecord> m_queue;
+		std::vector<SessionRecord> m_freeRecords;
+		OSVR_PositionState m_reference;
+		bool m_hasReference;
+		uint64_t m_droppedFrames;
+	};
+
+	class SessionReader {
+	public:
+		bool open(const std::string& path);
+		/// Reads the next record, false at the end of the session.
+		bool next(SessionRecord* record);
+		void rewind();
+
+	private:
+		std::ifstream m_file;
+		std::streampos m_firstRecord;
+	};
+
+}
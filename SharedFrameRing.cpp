@@ -0,0 +1,220 @@
+#include "SharedFrameRing.h"
+
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace com_samaust_trackerkudan_osvr {
+
+	static const uint32_t kRingMagic = 0x4b445246; // "KDRF"
+	static const uint32_t kRingVersion = 1;
+
+	static uint32_t alignTo64(size_t size) {
+		return static_cast<uint32_t>((size + 63) & ~static_cast<size_t>(63));
+	}
+
+	SharedFrameRing::SharedFrameRing() : m_ring(NULL), m_size(0), m_owner(false), m_pending(0), m_handle(NULL) {
+	}
+
+	SharedFrameRing::~SharedFrameRing() {
+		close();
+	}
+
+	bool SharedFrameRing::create(const std::string& name, uint32_t slotCount, uint32_t maxFrameBytes) {
+		close();
+		if (slotCount < 2) {
+			slotCount = 2;
+		}
+
+		m_name = name;
+		m_owner = true;
+
+		uint32_t slotSize = alignTo64(sizeof(SharedFrameHeader) + maxFrameBytes);
+		if (!map(sizeof(SharedRingHeader) + static_cast<size_t>(slotCount) * slotSize, true)) {
+			return false;
+		}
+
+		SharedRingHeader* ring = new (m_ring) SharedRingHeader();
+		ring->version = kRingVersion;
+		ring->slotCount = slotCount;
+		ring->slotSize = slotSize;
+		ring->writeIndex.store(0, std::memory_order_relaxed);
+		ring->readIndex.store(0, std::memory_order_relaxed);
+		// Publish the magic last so a consumer never sees a half initialized header
+		std::atomic_thread_fence(std::memory_order_release);
+		ring->magic = kRingMagic;
+
+		return true;
+	}
+
+	bool SharedFrameRing::open(const std::string& name) {
+		close();
+
+		m_name = name;
+		m_owner = false;
+
+		if (!map(0, false)) {
+			return false;
+		}
+
+		if (m_ring->magic != kRingMagic || m_ring->version != kRingVersion ||
+			m_size < sizeof(SharedRingHeader) + static_cast<size_t>(m_ring->slotCount) * m_ring->slotSize) {
+			std::cout << "[TrackerKudan-OSVR] Shared memory " << name << " is not a frame ring" << std::endl;
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	uint32_t SharedFrameRing::maxFrameBytes() const {
+		return m_ring ? m_ring->slotSize - static_cast<uint32_t>(sizeof(SharedFrameHeader)) : 0;
+	}
+
+	unsigned char* SharedFrameRing::slot(uint64_t index) const {
+		return reinterpret_cast<unsigned char*>(m_ring) + sizeof(SharedRingHeader) + (index % m_ring->slotCount) * m_ring->slotSize;
+	}
+
+	unsigned char* SharedFrameRing::beginWrite(SharedFrameHeader** header) {
+		uint64_t writeIndex = m_ring->writeIndex.load(std::memory_order_relaxed);
+		uint64_t readIndex = m_ring->readIndex.load(std::memory_order_acquire);
+
+		if (writeIndex - readIndex >= m_ring->slotCount) {
+			return NULL;
+		}
+
+		m_pending = writeIndex;
+		unsigned char* s = slot(writeIndex);
+		*header = reinterpret_cast<SharedFrameHeader*>(s);
+		return s + sizeof(SharedFrameHeader);
+	}
+
+	void SharedFrameRing::commitWrite() {
+		m_ring->writeIndex.store(m_pending + 1, std::memory_order_release);
+	}
+
+	const unsigned char* SharedFrameRing::acquireLatest(const SharedFrameHeader** header) {
+		uint64_t writeIndex = m_ring->writeIndex.load(std::memory_order_acquire);
+		uint64_t readIndex = m_ring->readIndex.load(std::memory_order_relaxed);
+
+		if (writeIndex == readIndex) {
+			return NULL;
+		}
+
+		// Everything up to writeIndex is handed back on release()
+		m_pending = writeIndex;
+		unsigned char* s = slot(writeIndex - 1);
+		*header = reinterpret_cast<const SharedFrameHeader*>(s);
+		return s + sizeof(SharedFrameHeader);
+	}
+
+	void SharedFrameRing::release() {
+		m_ring->readIndex.store(m_pending, std::memory_order_release);
+	}
+
+#ifdef _WIN32
+	bool SharedFrameRing::map(size_t size, bool create) {
+		HANDLE mapping;
+		if (create) {
+			unsigned long long size64 = size;
+			mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+				static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xffffffff), m_name.c_str());
+		}
+		else {
+			mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, m_name.c_str());
+		}
+		if (mapping == NULL) {
+			std::cout << "[TrackerKudan-OSVR] Could not open shared memory " << m_name << " (error " << GetLastError() << ")" << std::endl;
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (view == NULL) {
+			std::cout << "[TrackerKudan-OSVR] Could not map shared memory " << m_name << " (error " << GetLastError() << ")" << std::endl;
+			CloseHandle(mapping);
+			return false;
+		}
+
+		if (size == 0) {
+			MEMORY_BASIC_INFORMATION info;
+			VirtualQuery(view, &info, sizeof(info));
+			size = info.RegionSize;
+		}
+
+		m_handle = mapping;
+		m_ring = static_cast<SharedRingHeader*>(view);
+		m_size = size;
+		return true;
+	}
+
+	void SharedFrameRing::close() {
+		if (m_ring) {
+			UnmapViewOfFile(m_ring);
+			m_ring = NULL;
+		}
+		if (m_handle) {
+			CloseHandle(static_cast<HANDLE>(m_handle));
+			m_handle = NULL;
+		}
+		m_size = 0;
+	}
+#else
+	bool SharedFrameRing::map(size_t size, bool create) {
+		std::string path = "/" + m_name;
+		int fd;
+		if (create) {
+			shm_unlink(path.c_str());
+			fd = shm_open(path.c_str(), O_CREAT | O_RDWR, 0600);
+			if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+				::close(fd);
+				fd = -1;
+			}
+		}
+		else {
+			fd = shm_open(path.c_str(), O_RDWR, 0600);
+			struct stat st;
+			if (fd >= 0 && fstat(fd, &st) == 0) {
+				size = static_cast<size_t>(st.st_size);
+			}
+		}
+		if (fd < 0 || size < sizeof(SharedRingHeader)) {
+			std::cout << "[TrackerKudan-OSVR] Could not open shared memory " << m_name << std::endl;
+			if (fd >= 0) {
+				::close(fd);
+			}
+			return false;
+		}
+
+		void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED) {
+			std::cout << "[TrackerKudan-OSVR] Could not map shared memory " << m_name << std::endl;
+			return false;
+		}
+
+		m_ring = static_cast<SharedRingHeader*>(view);
+		m_size = size;
+		return true;
+	}
+
+	void SharedFrameRing::close() {
+		if (m_ring) {
+			munmap(m_ring, m_size);
+			m_ring = NULL;
+			if (m_owner) {
+				shm_unlink(("/" + m_name).c_str());
+			}
+		}
+		m_size = 0;
+	}
+#endif
+
+}
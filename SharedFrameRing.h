@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Pixel formats a producer may publish into the ring.
+	enum SharedFrameFormat {
+		SHARED_FRAME_GREY8 = 1,
+		SHARED_FRAME_BGR24 = 2
+	};
+
+	/// Written by the producer in front of every frame slot.
+	struct SharedFrameHeader {
+		uint64_t sequence;
+		uint64_t timestampUs;	// producer clock, microseconds
+		uint32_t width;
+		uint32_t height;
+		uint32_t stride;		// bytes per row, at least width * channels
+		uint32_t format;		// SharedFrameFormat
+	};
+
+	/// Lives at the start of the mapping. Indices only ever grow, the slot is index % slotCount.
+	/// Slots in [readIndex, writeIndex) belong to the consumer, the others to the producer.
+	struct SharedRingHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCount;
+		uint32_t slotSize;
+		alignas(64) std::atomic<uint64_t> writeIndex;
+		alignas(64) std::atomic<uint64_t> readIndex;
+	};
+
+	/// Single producer / single consumer frame ring in named shared memory.
+	/// The producer copies frames in, the consumer reads them in place.
+	class SharedFrameRing {
+	public:
+		SharedFrameRing();
+		~SharedFrameRing();
+
+		/// Producer side: create (or replace) the named mapping.
+		bool create(const std::string& name, uint32_t slotCount, uint32_t maxFrameBytes);
+		/// Consumer side: attach to a mapping created by a producer.
+		bool open(const std::string& name);
+		void close();
+		bool isOpen() const { return m_ring != NULL; }
+
+		uint32_t maxFrameBytes() const;
+
+		/// Reserve the next slot. Returns NULL when the consumer still holds every slot, in which case the frame should be dropped.
+		unsigned char* beginWrite(SharedFrameHeader** header);
+		void commitWrite();
+
+		/// Skip to the newest published frame. Older unread frames are discarded. The data stays valid until release().
+		const unsigned char* acquireLatest(const SharedFrameHeader** header);
+		void release();
+
+	private:
+		bool map(size_t size, bool create);
+		unsigned char* slot(uint64_t index) const;
+
+		std::string m_name;
+		SharedRingHeader* m_ring;
+		size_t m_size;
+		bool m_owner;
+		uint64_t m_pending;
+		void* m_handle;
+	};
+
+}
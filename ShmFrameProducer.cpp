@@ -0,0 +1,182 @@
+// Reference producer for cameraType 2: publishes frames from a video file, a camera or a synthetic
+// pattern into the shared memory ring read by SharedMemoryFrameSource.
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "SharedFrameRing.h"
+
+using namespace com_samaust_trackerkudan_osvr;
+
+static void usage() {
+	std::cout << "Usage: trackerkudan_shm_producer [options]" << std::endl
+		<< "  --name <name>       shared memory name (default TrackerKudanFrames)" << std::endl
+		<< "  --file <path>       read frames from a video file, looped" << std::endl
+		<< "  --camera <index>    read frames from a camera" << std::endl
+		<< "  --pattern           synthetic moving pattern (default)" << std::endl
+		<< "  --size <w> <h>      pattern size (default 640 480)" << std::endl
+		<< "  --fps <fps>         publishing rate (default 60)" << std::endl
+		<< "  --grey              publish greyscale instead of BGR" << std::endl
+		<< "  --slots <n>         ring slots (default 4)" << std::endl;
+}
+
+// Textured background with random blobs so Arbitrack has features to follow, panned along an ellipse
+static void renderPattern(const cv::Mat& texture, cv::Mat& frame, double t) {
+	int maxX = texture.cols - frame.cols;
+	int maxY = texture.rows - frame.rows;
+	int x = static_cast<int>(maxX * (0.5 + 0.5 * std::sin(t * 0.7)));
+	int y = static_cast<int>(maxY * (0.5 + 0.5 * std::cos(t * 0.5)));
+	texture(cv::Rect(x, y, frame.cols, frame.rows)).copyTo(frame);
+}
+
+int main(int argc, char** argv) {
+	std::string name = "TrackerKudanFrames";
+	std::string file;
+	int cameraIndex = -1;
+	int width = 640;
+	int height = 480;
+	double fps = 60;
+	bool grey = false;
+	int slots = 4;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--name" && i + 1 < argc) {
+			name = argv[++i];
+		}
+		else if (arg == "--file" && i + 1 < argc) {
+			file = argv[++i];
+		}
+		else if (arg == "--camera" && i + 1 < argc) {
+			cameraIndex = std::atoi(argv[++i]);
+		}
+		else if (arg == "--pattern") {
+			file.clear();
+			cameraIndex = -1;
+		}
+		else if (arg == "--size" && i + 2 < argc) {
+			width = std::atoi(argv[++i]);
+			height = std::atoi(argv[++i]);
+		}
+		else if (arg == "--fps" && i + 1 < argc) {
+			fps = std::atof(argv[++i]);
+		}
+		else if (arg == "--grey") {
+			grey = true;
+		}
+		else if (arg == "--slots" && i + 1 < argc) {
+			slots = std::atoi(argv[++i]);
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	cv::VideoCapture capture;
+	if (!file.empty()) {
+		capture.open(file);
+	}
+	else if (cameraIndex >= 0) {
+		capture.open(cameraIndex);
+	}
+	bool usePattern = !capture.isOpened();
+	if (usePattern && (!file.empty() || cameraIndex >= 0)) {
+		std::cout << "[TrackerKudan-OSVR] Could not open capture, publishing the synthetic pattern instead" << std::endl;
+	}
+
+	cv::Mat frame;
+	cv::Mat texture;
+	if (usePattern) {
+		frame.create(height, width, CV_8UC3);
+		texture.create(height * 2, width * 2, CV_8UC3);
+		cv::randu(texture, cv::Scalar::all(0), cv::Scalar::all(64));
+		cv::RNG rng(42);
+		for (int i = 0; i < 400; i++) {
+			cv::circle(texture, cv::Point(rng.uniform(0, texture.cols), rng.uniform(0, texture.rows)), rng.uniform(4, 40),
+				cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)), -1);
+		}
+	}
+	else {
+		capture.read(frame);
+		width = frame.cols;
+		height = frame.rows;
+	}
+
+	int channels = grey ? 1 : 3;
+	SharedFrameRing ring;
+	if (!ring.create(name, slots, width * height * channels)) {
+		return 1;
+	}
+	std::cout << "[TrackerKudan-OSVR] Publishing " << width << " x " << height << (grey ? " grey" : " BGR")
+		<< " frames at " << fps << " fps on " << name << std::endl;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration period = std::chrono::microseconds(static_cast<long long>(1e6 / fps));
+	std::chrono::steady_clock::time_point next = start;
+	uint64_t sequence = 0;
+	uint64_t dropped = 0;
+	cv::Mat converted;
+
+	while (true) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (usePattern) {
+			renderPattern(texture, frame, std::chrono::duration<double>(now - start).count());
+		}
+		else if (!capture.read(frame) || frame.cols != width || frame.rows != height) {
+			if (!file.empty()) {
+				capture.set(cv::CAP_PROP_POS_FRAMES, 0);
+				continue;
+			}
+			std::cout << "[TrackerKudan-OSVR] Capture ended" << std::endl;
+			break;
+		}
+		uint64_t timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+
+		const cv::Mat* source = &frame;
+		if (grey) {
+			cv::cvtColor(frame, converted, cv::COLOR_BGR2GRAY);
+			source = &converted;
+		}
+
+		SharedFrameHeader* header;
+		unsigned char* data = ring.beginWrite(&header);
+		if (data == NULL) {
+			dropped++;
+		}
+		else {
+			size_t rowBytes = static_cast<size_t>(width) * channels;
+			for (int row = 0; row < height; row++) {
+				std::memcpy(data + row * rowBytes, source->ptr(row), rowBytes);
+			}
+			header->sequence = sequence;
+			header->timestampUs = timestampUs;
+			header->width = width;
+			header->height = height;
+			header->stride = static_cast<uint32_t>(rowBytes);
+			header->format = grey ? SHARED_FRAME_GREY8 : SHARED_FRAME_BGR24;
+			ring.commitWrite();
+		}
+
+		sequence++;
+		if (sequence % 600 == 0) {
+			std::cout << "[TrackerKudan-OSVR] " << sequence << " frames, " << dropped << " dropped (consumer busy)" << std::endl;
+		}
+
+		if (usePattern || !file.empty()) {
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+	return 0;
+}
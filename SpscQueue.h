@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Bounded lock-free queue between one producer thread and one consumer thread. Elements are
+	/// preallocated and filled in place, so neither side allocates, blocks or retries: the producer
+	/// is told the queue is full and the consumer that it is empty.
+	/// The producer (or consumer) may change thread as long as its calls do not overlap.
+	template <class T>
+	class SpscQueue {
+	public:
+		/// capacity is rounded up to a power of two. Every element starts as a copy of prototype, for
+		/// elements owning buffers that must not grow on the producer side.
+		explicit SpscQueue(size_t capacity, const T& prototype = T()) : m_head(0), m_tail(0) {
+			size_t size = 1;
+			while (size < capacity) {
+				size *= 2;
+			}
+			m_elements.resize(size, prototype);
+			m_mask = size - 1;
+		}
+
+		/// Producer: element to fill, NULL when full. Published by commitPush.
+		T* beginPush() {
+			size_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+				return NULL;
+			}
+			return &m_elements[tail & m_mask];
+		}
+
+		void commitPush() {
+			m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		/// Consumer: oldest element, NULL when empty. Released by pop.
+		T* front() {
+			size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail.load(std::memory_order_acquire)) {
+				return NULL;
+			}
+			return &m_elements[head & m_mask];
+		}
+
+		void pop() {
+			m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+	private:
+		std::vector<T> m_elements;
+		size_t m_mask;
+
+		// Own cache lines, the two sides write them concurrently
+		alignas(64) std::atomic<size_t> m_head;	// next element to consume, written by the consumer
+		alignas(64) std::atomic<size_t> m_tail;	// next element to produce, written by the producer
+	};
+
+}
@@ -0,0 +1,371 @@
+#include "TelemetryTap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+static const SocketHandle kNoSocket = INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int SocketHandle;
+static const SocketHandle kNoSocket = -1;
+#endif
+
+namespace com_samaust_trackerkudan_osvr {
+
+	static const size_t kSampleCapacity = 1024;
+	static const size_t kFrameCapacity = 4;
+	static const int kDefaultPort = 7781;
+
+	// Ports of the taps of this process, by device
+	static std::mutex g_portsMutex;
+	static std::map<int, std::string> g_ports;
+
+	/// The configured port, or the first free one from kDefaultPort. 0 when another device has the configured port.
+	static int reservePort(const std::string& device, const Json::Value& config) {
+		std::lock_guard<std::mutex> lock(g_portsMutex);
+		if (config.isMember("port")) {
+			int port = config["port"].asInt();
+			std::map<int, std::string>::const_iterator owner = g_ports.find(port);
+			if (owner != g_ports.end()) {
+				std::cout << "[TrackerKudan-OSVR] Telemetry port " << port << " of " << device << " is already used by " << owner->second
+					<< ", telemetry disabled, set another \"port\"" << std::endl;
+				return 0;
+			}
+			g_ports[port] = device;
+			return port;
+		}
+		int port = kDefaultPort;
+		while (g_ports.count(port)) {
+			port++;
+		}
+		g_ports[port] = device;
+		return port;
+	}
+
+	static void releasePort(int port) {
+		std::lock_guard<std::mutex> lock(g_portsMutex);
+		g_ports.erase(port);
+	}
+
+	static TelemetryFrame framePrototype(int frameWidth) {
+		TelemetryFrame frame;
+		frame.timeUs = 0;
+		frame.width = 0;
+		frame.height = 0;
+		if (frameWidth > 0) {
+			frame.pixels.resize(static_cast<size_t>(frameWidth) * frameWidth);
+		}
+		return frame;
+	}
+
+	static uint64_t nowUs() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static void closeSocket(SocketHandle socket) {
+#ifdef _WIN32
+		closesocket(socket);
+#else
+		close(socket);
+#endif
+	}
+
+	static void setNonBlocking(SocketHandle socket, bool nonBlocking) {
+#ifdef _WIN32
+		u_long mode = nonBlocking ? 1 : 0;
+		ioctlsocket(socket, FIONBIO, &mode);
+#else
+		int flags = fcntl(socket, F_GETFL, 0);
+		fcntl(socket, F_SETFL, nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+#endif
+	}
+
+	// Loopback only, the telemetry is not meant to leave the machine
+	static SocketHandle listenLocal(int port) {
+		SocketHandle listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listener == kNoSocket) {
+			return kNoSocket;
+		}
+		int reuse = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(static_cast<unsigned short>(port));
+		if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0) {
+			closeSocket(listener);
+			return kNoSocket;
+		}
+		setNonBlocking(listener, true);
+		return listener;
+	}
+
+	static bool sendAll(SocketHandle socket, const std::string& data) {
+		size_t sent = 0;
+		while (sent < data.size()) {
+#ifdef MSG_NOSIGNAL
+			int flags = MSG_NOSIGNAL;
+#else
+			int flags = 0;
+#endif
+			int result = static_cast<int>(send(socket, data.data() + sent, static_cast<int>(data.size() - sent), flags));
+			if (result <= 0) {
+				return false;
+			}
+			sent += result;
+		}
+		return true;
+	}
+
+	static void appendSample(std::string& buffer, const TelemetrySample& sample) {
+		char line[256];
+		switch (sample.type) {
+		case TELEMETRY_POSE:
+			snprintf(line, sizeof(line), "{\"type\":\"pose\",\"t\":%llu,\"p\":[%.6f,%.6f,%.6f],\"q\":[%.6f,%.6f,%.6f,%.6f]}\n",
+				static_cast<unsigned long long>(sample.timeUs), sample.position[0], sample.position[1], sample.position[2],
+				sample.orientation[0], sample.orientation[1], sample.orientation[2], sample.orientation[3]);
+			break;
+		case TELEMETRY_RAW_POSITION:
+			snprintf(line, sizeof(line), "{\"type\":\"raw\",\"t\":%llu,\"p\":[%.6f,%.6f,%.6f]}\n",
+				static_cast<unsigned long long>(sample.timeUs), sample.position[0], sample.position[1], sample.position[2]);
+			break;
+		case TELEMETRY_TRACKING_STATE:
+			snprintf(line, sizeof(line), "{\"type\":\"state\",\"t\":%llu,\"tracking\":%s,\"frames\":%u}\n",
+				static_cast<unsigned long long>(sample.timeUs), sample.tracking ? "true" : "false", sample.trackedFrames);
+			break;
+		case TELEMETRY_CAMERA_CLOCK:
+			snprintf(line, sizeof(line), "{\"type\":\"clock\",\"t\":%llu,\"sourceClock\":%s,\"offset\":%.6f,\"drift\":%.3f,\"residual\":%.3f}\n",
+				static_cast<unsigned long long>(sample.timeUs), sample.sourceClock ? "true" : "false", sample.clock[0], sample.clock[1], sample.clock[2]);
+			break;
+		}
+		buffer += line;
+	}
+
+	static void appendQueueStats(std::string& buffer, const char* name, const TelemetryQueueStats& stats) {
+		char text[128];
+		snprintf(text, sizeof(text), "\"%s\":{\"published\":%llu,\"dropped\":%llu}", name,
+			static_cast<unsigned long long>(stats.published), static_cast<unsigned long long>(stats.dropped));
+		buffer += text;
+	}
+
+	TelemetryTap::TelemetryTap(const std::string& device, const Json::Value& config, ThreadPlacement placement)
+		: m_frameWidth(config.get("frameWidth", 160).asInt()), m_poses(kSampleCapacity), m_tracking(kSampleCapacity),
+		m_frames(kFrameCapacity, framePrototype(m_frameWidth)) {
+		m_device = device;
+		m_port = reservePort(device, config);
+		double frameRate = config.get("frameRate", 2.0).asDouble();
+		m_framePeriodUs = frameRate > 0 ? static_cast<uint64_t>(1e6 / frameRate) : 0;
+		m_nextFrameUs = 0;
+
+		m_posesPublished = 0;
+		m_posesDropped = 0;
+		m_trackingPublished = 0;
+		m_trackingDropped = 0;
+		m_framesPublished = 0;
+		m_framesDropped = 0;
+		m_viewerConnected = false;
+
+		m_placement = placement;
+		m_stop = false;
+		m_thread = std::thread(&TelemetryTap::run, this);
+	}
+
+	TelemetryTap::~TelemetryTap() {
+		m_stop = true;
+		m_thread.join();
+		if (m_port != 0) {
+			releasePort(m_port);
+		}
+	}
+
+	bool TelemetryTap::pushSample(SpscQueue<TelemetrySample>& queue, const TelemetrySample& sample, std::atomic<uint64_t>& published, std::atomic<uint64_t>& dropped) {
+		TelemetrySample* slot = queue.beginPush();
+		if (!slot) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		*slot = sample;
+		queue.commitPush();
+		published.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void TelemetryTap::publishPose(const double position[3], const double orientation[4]) {
+		TelemetrySample sample;
+		sample.type = TELEMETRY_POSE;
+		sample.timeUs = nowUs();
+		memcpy(sample.position, position, sizeof(sample.position));
+		memcpy(sample.orientation, orientation, sizeof(sample.orientation));
+		pushSample(m_poses, sample, m_posesPublished, m_posesDropped);
+	}
+
+	void TelemetryTap::publishRawPosition(const double position[3]) {
+		TelemetrySample sample;
+		sample.type = TELEMETRY_RAW_POSITION;
+		sample.timeUs = nowUs();
+		memcpy(sample.position, position, sizeof(sample.position));
+		pushSample(m_tracking, sample, m_trackingPublished, m_trackingDropped);
+	}
+
+	void TelemetryTap::publishTrackingState(bool tracking, uint32_t trackedFrames) {
+		TelemetrySample sample;
+		sample.type = TELEMETRY_TRACKING_STATE;
+		sample.timeUs = nowUs();
+		sample.tracking = tracking;
+		sample.trackedFrames = trackedFrames;
+		pushSample(m_tracking, sample, m_trackingPublished, m_trackingDropped);
+	}
+
+	void TelemetryTap::publishCameraClock(double offset, double driftPpm, double residualMs, bool sourceClock) {
+		TelemetrySample sample;
+		sample.type = TELEMETRY_CAMERA_CLOCK;
+		sample.timeUs = nowUs();
+		sample.clock[0] = offset;
+		sample.clock[1] = driftPpm;
+		sample.clock[2] = residualMs;
+		sample.sourceClock = sourceClock;
+		pushSample(m_tracking, sample, m_trackingPublished, m_trackingDropped);
+	}
+
+	bool TelemetryTap::wantsFrame() {
+		return m_framePeriodUs > 0 && nowUs() >= m_nextFrameUs;
+	}
+
+	void TelemetryTap::publishFrame(const uint8_t* data, int width, int height, int stride) {
+		uint64_t now = nowUs();
+		m_nextFrameUs = now + m_framePeriodUs;
+
+		TelemetryFrame* slot = m_frames.beginPush();
+		if (!slot || static_cast<size_t>(width) * height > slot->pixels.size()) {
+			m_framesDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		slot->timeUs = now;
+		slot->width = width;
+		slot->height = height;
+		for (int y = 0; y < height; y++) {
+			memcpy(&slot->pixels[static_cast<size_t>(y) * width], data + static_cast<size_t>(y) * stride, width);
+		}
+		m_frames.commitPush();
+		m_framesPublished.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	TelemetryStats TelemetryTap::getStats() const {
+		TelemetryStats stats;
+		stats.poses.published = m_posesPublished.load(std::memory_order_relaxed);
+		stats.poses.dropped = m_posesDropped.load(std::memory_order_relaxed);
+		stats.tracking.published = m_trackingPublished.load(std::memory_order_relaxed);
+		stats.tracking.dropped = m_trackingDropped.load(std::memory_order_relaxed);
+		stats.frames.published = m_framesPublished.load(std::memory_order_relaxed);
+		stats.frames.dropped = m_framesDropped.load(std::memory_order_relaxed);
+		stats.viewerConnected = m_viewerConnected;
+		return stats;
+	}
+
+	void TelemetryTap::run() {
+		applyThreadPlacement(m_placement);
+
+#ifdef _WIN32
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+		SocketHandle listener = m_port != 0 ? listenLocal(m_port) : kNoSocket;
+		if (listener != kNoSocket) {
+			std::cout << "[TrackerKudan-OSVR] Telemetry of " << m_device << " listening on 127.0.0.1:" << m_port << std::endl;
+		}
+		else if (m_port != 0) {
+			std::cout << "[TrackerKudan-OSVR] Telemetry of " << m_device << " could not listen on 127.0.0.1:" << m_port
+				<< ", the port is taken by another program, samples are discarded, set another \"port\"" << std::endl;
+		}
+
+		SocketHandle viewer = kNoSocket;
+		std::string buffer;
+		uint64_t nextStatsUs = nowUs() + 1000000;
+
+		while (!m_stop) {
+			if (viewer == kNoSocket && listener != kNoSocket) {
+				viewer = accept(listener, NULL, NULL);
+				if (viewer != kNoSocket) {
+					// Blocking sends, bounded so that a stuck viewer is dropped
+					setNonBlocking(viewer, false);
+#ifdef _WIN32
+					DWORD timeout = 500;
+#else
+					timeval timeout = { 0, 500000 };
+#endif
+					setsockopt(viewer, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+					m_viewerConnected = true;
+					std::cout << "[TrackerKudan-OSVR] Telemetry viewer connected" << std::endl;
+				}
+			}
+
+			TelemetrySample* sample;
+			while ((sample = m_poses.front()) != NULL) {
+				appendSample(buffer, *sample);
+				m_poses.pop();
+			}
+			while ((sample = m_tracking.front()) != NULL) {
+				appendSample(buffer, *sample);
+				m_tracking.pop();
+			}
+			TelemetryFrame* frame;
+			while ((frame = m_frames.front()) != NULL) {
+				char header[128];
+				snprintf(header, sizeof(header), "{\"type\":\"frame\",\"t\":%llu,\"width\":%d,\"height\":%d,\"bytes\":%d}\n",
+					static_cast<unsigned long long>(frame->timeUs), frame->width, frame->height, frame->width * frame->height);
+				buffer += header;
+				buffer.append(reinterpret_cast<const char*>(frame->pixels.data()), static_cast<size_t>(frame->width) * frame->height);
+				m_frames.pop();
+			}
+
+			if (nowUs() >= nextStatsUs) {
+				TelemetryStats stats = getStats();
+				buffer += "{\"type\":\"stats\",";
+				appendQueueStats(buffer, "poses", stats.poses);
+				buffer += ",";
+				appendQueueStats(buffer, "tracking", stats.tracking);
+				buffer += ",";
+				appendQueueStats(buffer, "frames", stats.frames);
+				buffer += "}\n";
+				nextStatsUs += 1000000;
+			}
+
+			if (viewer != kNoSocket && !buffer.empty() && !sendAll(viewer, buffer)) {
+				closeSocket(viewer);
+				viewer = kNoSocket;
+				m_viewerConnected = false;
+				std::cout << "[TrackerKudan-OSVR] Telemetry viewer disconnected" << std::endl;
+			}
+			buffer.clear();
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+
+		if (viewer != kNoSocket) {
+			closeSocket(viewer);
+		}
+		if (listener != kNoSocket) {
+			closeSocket(listener);
+		}
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+}
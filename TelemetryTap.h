@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <json/json.h>
+
+#include "SpscQueue.h"
+#include "ThreadPlacement.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	enum TelemetrySampleType {
+		TELEMETRY_POSE,				// published pose
+		TELEMETRY_RAW_POSITION,		// Kudan position before drift correction, filter and offset
+		TELEMETRY_TRACKING_STATE,	// Arbitrack running, frames tracked so far
+		TELEMETRY_CAMERA_CLOCK		// camera to OSVR clock estimate
+	};
+
+	struct TelemetrySample {
+		TelemetrySampleType type;
+		uint64_t timeUs;
+		double position[3];
+		double orientation[4];	// w, x, y, z, poses only
+		bool tracking;
+		uint32_t trackedFrames;
+		double clock[3];		// offset (s), drift (ppm), residual (ms), camera clock only
+		bool sourceClock;
+	};
+
+	struct TelemetryFrame {
+		uint64_t timeUs;
+		int width;
+		int height;
+		std::vector<uint8_t> pixels;	// preallocated to the largest frame, starts with width * height greyscale
+	};
+
+	struct TelemetryQueueStats {
+		uint64_t published;
+		uint64_t dropped;
+	};
+
+	struct TelemetryStats {
+		TelemetryQueueStats poses;
+		TelemetryQueueStats tracking;
+		TelemetryQueueStats frames;
+		bool viewerConnected;
+	};
+
+	/// Opt-in live view of the fusion, for debugging without a debugger or console prints. Samples
+	/// go into bounded lock-free queues, one per producer thread, and a background thread sends them
+	/// to a viewer connected on a local TCP port, as JSON lines. Frames are a line giving their
+	/// size followed by the greyscale pixels.
+	/// Publishing never blocks: a sample that does not fit because the viewer lags is dropped and
+	/// counted. Without viewer the samples are discarded.
+	/// Each device has its own tap and port. Without "port", devices take the first port from 7781 up
+	/// that no other device of the server uses.
+	class TelemetryTap {
+	public:
+		/// config is the "telemetry" device param: { "port", "frameRate" (Hz), "frameWidth" (pixels) }.
+		TelemetryTap(const std::string& device, const Json::Value& config, ThreadPlacement placement);
+		~TelemetryTap();
+
+		/// Update thread.
+		void publishPose(const double position[3], const double orientation[4]);
+
+		/// Tracking thread, for the next four.
+		void publishRawPosition(const double position[3]);
+		void publishTrackingState(bool tracking, uint32_t trackedFrames);
+		void publishCameraClock(double offset, double driftPpm, double residualMs, bool sourceClock);
+
+		/// True when a frame is due, to skip the downsampling otherwise.
+		bool wantsFrame();
+		/// Width frames should be downsampled to, at most.
+		int frameWidth() const { return m_frameWidth; }
+		/// Greyscale frame (row padding allowed), already downsampled. Frames taller than wide are dropped,
+		/// they would not fit the preallocated slots.
+		void publishFrame(const uint8_t* data, int width, int height, int stride);
+
+		TelemetryStats getStats() const;
+
+	private:
+		void run();
+		bool pushSample(SpscQueue<TelemetrySample>& queue, const TelemetrySample& sample, std::atomic<uint64_t>& published, std::atomic<uint64_t>& dropped);
+
+		std::string m_device;
+		int m_port;		// 0 when another device has it
+		int m_frameWidth;
+		uint64_t m_framePeriodUs;
+		uint64_t m_nextFrameUs;	// tracking thread only
+
+		SpscQueue<TelemetrySample> m_poses;
+		SpscQueue<TelemetrySample> m_tracking;
+		SpscQueue<TelemetryFrame> m_frames;
+
+		std::atomic<uint64_t> m_posesPublished;
+		std::atomic<uint64_t> m_posesDropped;
+		std::atomic<uint64_t> m_trackingPublished;
+		std::atomic<uint64_t> m_trackingDropped;
+		std::atomic<uint64_t> m_framesPublished;
+		std::atomic<uint64_t> m_framesDropped;
+		std::atomic<bool> m_viewerConnected;
+
+		ThreadPlacement m_placement;
+		std::atomic<bool> m_stop;
+		std::thread m_thread;
+	};
+
+}
@@ -0,0 +1,178 @@
+// Frame latency distribution of a simulated tracking thread under synthetic CPU load,
+// with the default placement and with the placement given on the command line.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThreadPlacement.h"
+
+using namespace com_samaust_trackerkudan_osvr;
+
+typedef std::chrono::steady_clock Clock;
+
+static void usage() {
+	std::cout << "Usage: trackerkudan_jitter_bench [options]" << std::endl
+		<< "  --frames <n>        frames per run (default 1200)" << std::endl
+		<< "  --fps <fps>         frame rate (default 60)" << std::endl
+		<< "  --work <us>         processing time per frame (default 3000)" << std::endl
+		<< "  --load <n>          busy load threads (default one per core)" << std::endl
+		<< "  --cpu <index>       CPU to pin the tracking thread to (default last core)" << std::endl
+		<< "  --policy <policy>   normal, fifo or rr for the pinned run (default fifo)" << std::endl
+		<< "  --priority <n>      priority for the pinned run" << std::endl;
+}
+
+// Fixed amount of computation for the frame work rather than a wall clock spin, so that a
+// preempted tracking thread finishes late instead of appearing to finish on time
+static double g_iterationsPerUs = 0;
+
+static double burn(long long iterations) {
+	double sink = 0;
+	for (long long i = 0; i < iterations; i++) {
+		sink = sink * 0.999 + i * 0.5;
+	}
+	return sink;
+}
+
+// Iterations per microsecond, measured before the load starts
+static void calibrate() {
+	long long iterations = 1000000;
+	volatile double sink = burn(iterations);
+	Clock::time_point start = Clock::now();
+	sink = sink + burn(iterations * 20);
+	g_iterationsPerUs = iterations * 20 / std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Load only needs to keep its core busy
+static void spin(std::chrono::microseconds duration) {
+	Clock::time_point end = Clock::now() + duration;
+	volatile double sink = 0;
+	while (Clock::now() < end) {
+		for (int i = 0; i < 1000; i++) {
+			sink = sink + i * 0.5;
+		}
+	}
+}
+
+// Latency of a frame is the time from its nominal arrival to the end of its processing
+static std::vector<double> runFrames(const ThreadPlacement* placement, int frames, double fps, int workUs) {
+	std::vector<double> latencies;
+	latencies.reserve(frames);
+
+	std::thread tracking([&]() {
+		if (placement) {
+			applyThreadPlacement(*placement);
+		}
+		Clock::duration period = std::chrono::microseconds(static_cast<long long>(1e6 / fps));
+		Clock::time_point arrival = Clock::now() + period;
+		for (int i = 0; i < frames; i++) {
+			std::this_thread::sleep_until(arrival);
+			volatile double sink = burn(static_cast<long long>(workUs * g_iterationsPerUs));
+			(void)sink;
+			latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - arrival).count());
+			arrival += period;
+			// Do not accumulate lateness, a real camera does not wait either
+			Clock::time_point now = Clock::now();
+			while (arrival < now) {
+				arrival += period;
+			}
+		}
+	});
+	tracking.join();
+
+	return latencies;
+}
+
+static void report(const std::string& label, std::vector<double> latencies, int workUs) {
+	std::sort(latencies.begin(), latencies.end());
+	size_t n = latencies.size();
+	if (n == 0) {
+		std::cout << label << ": no frame" << std::endl;
+		return;
+	}
+	std::cout << label << " (us, ideal " << workUs << "):"
+		<< " p50 " << latencies[n / 2]
+		<< " p90 " << latencies[n * 9 / 10]
+		<< " p99 " << latencies[n * 99 / 100]
+		<< " p99.9 " << latencies[std::min(n - 1, n * 999 / 1000)]
+		<< " max " << latencies[n - 1] << std::endl;
+}
+
+int main(int argc, char** argv) {
+	int frames = 1200;
+	double fps = 60;
+	int workUs = 3000;
+	int cores = std::max(1u, std::thread::hardware_concurrency());
+	int loadThreads = cores;
+
+	ThreadPlacement pinned;
+	pinned.name = "kudan-bench";
+	pinned.cpus.push_back(cores - 1);
+	pinned.policy = SCHEDULING_FIFO;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc) {
+			frames = std::atoi(argv[++i]);
+		}
+		else if (arg == "--fps" && i + 1 < argc) {
+			fps = std::atof(argv[++i]);
+		}
+		else if (arg == "--work" && i + 1 < argc) {
+			workUs = std::atoi(argv[++i]);
+		}
+		else if (arg == "--load" && i + 1 < argc) {
+			loadThreads = std::atoi(argv[++i]);
+		}
+		else if (arg == "--cpu" && i + 1 < argc) {
+			pinned.cpus.assign(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--policy" && i + 1 < argc) {
+			std::string policy = argv[++i];
+			pinned.policy = policy == "rr" ? SCHEDULING_ROUND_ROBIN : policy == "normal" ? SCHEDULING_NORMAL : SCHEDULING_FIFO;
+		}
+		else if (arg == "--priority" && i + 1 < argc) {
+			pinned.priority = std::atoi(argv[++i]);
+			pinned.hasPriority = true;
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (frames < 1 || fps <= 0 || workUs < 0 || loadThreads < 0) {
+		usage();
+		return 1;
+	}
+
+	calibrate();
+
+	std::atomic<bool> loaded(true);
+	std::vector<std::thread> load;
+	for (int i = 0; i < loadThreads; i++) {
+		load.push_back(std::thread([&loaded]() {
+			while (loaded) {
+				spin(std::chrono::microseconds(1000));
+			}
+		}));
+	}
+
+	std::cout << frames << " frames at " << fps << " fps, " << workUs << " us of work each, "
+		<< loadThreads << " load threads on " << cores << " cores" << std::endl;
+
+	report("default placement", runFrames(NULL, frames, fps, workUs), workUs);
+	report("pinned placement ", runFrames(&pinned, frames, fps, workUs), workUs);
+
+	loaded = false;
+	for (size_t i = 0; i < load.size(); i++) {
+		load[i].join();
+	}
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+#include "ThreadPlacement.h"
+
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#endif
+
+namespace com_samaust_trackerkudan_osvr {
+
+	// CPU indices beyond the machine, or beyond what an affinity mask holds, are skipped
+	static bool isValidCpu(int cpu, const std::string& name) {
+#if defined(_WIN32)
+		int limit = static_cast<int>(sizeof(DWORD_PTR) * 8);
+#elif defined(__linux__)
+		int limit = CPU_SETSIZE;
+#else
+		int limit = 64;
+#endif
+		unsigned int cpus = std::thread::hardware_concurrency();
+		if (cpus > 0 && static_cast<int>(cpus) < limit) {
+			limit = static_cast<int>(cpus);
+		}
+		if (cpu < 0 || cpu >= limit) {
+			std::cout << "[TrackerKudan-OSVR] CPU " << cpu << " of " << name << " is out of range [0, " << limit - 1 << "], skipped" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	ThreadPlacement getThreadPlacement(const Json::Value& config, const std::string& role) {
+		ThreadPlacement placement;
+		placement.name = "kudan-" + role;
+
+		if (!config.isMember("threads") || !config["threads"].isMember(role)) {
+			return placement;
+		}
+		const Json::Value& entry = config["threads"][role];
+
+		if (entry.isMember("name")) {
+			placement.name = entry["name"].asString();
+		}
+		if (entry["cpus"].isArray()) {
+			for (Json::ArrayIndex i = 0; i < entry["cpus"].size(); i++) {
+				placement.cpus.push_back(entry["cpus"][i].asInt());
+			}
+		}
+		if (entry.isMember("policy")) {
+			std::string policy = entry["policy"].asString();
+			if (policy == "fifo") {
+				placement.policy = SCHEDULING_FIFO;
+			}
+			else if (policy == "rr") {
+				placement.policy = SCHEDULING_ROUND_ROBIN;
+			}
+			else if (policy == "normal" || policy == "other") {
+				placement.policy = SCHEDULING_NORMAL;
+			}
+			else {
+				std::cout << "[TrackerKudan-OSVR] Unknown scheduling policy \"" << policy << "\" for thread " << role << ", ignored" << std::endl;
+			}
+		}
+		if (entry.isMember("priority")) {
+			placement.priority = entry["priority"].asInt();
+			placement.hasPriority = true;
+		}
+
+		return placement;
+	}
+
+#ifdef _WIN32
+	typedef HRESULT(WINAPI *SetThreadDescriptionFunc)(HANDLE, PCWSTR);
+
+	bool applyThreadPlacement(const ThreadPlacement& placement) {
+		bool applied = true;
+		HANDLE thread = GetCurrentThread();
+
+		if (!placement.name.empty()) {
+			// Only available from Windows 10 1607, look it up at run time
+			SetThreadDescriptionFunc setThreadDescription = reinterpret_cast<SetThreadDescriptionFunc>(
+				GetProcAddress(GetModuleHandleA("kernel32.dll"), "SetThreadDescription"));
+			if (setThreadDescription) {
+				std::wstring name(placement.name.begin(), placement.name.end());
+				setThreadDescription(thread, name.c_str());
+			}
+		}
+
+		if (!placement.cpus.empty()) {
+			DWORD_PTR mask = 0;
+			for (size_t i = 0; i < placement.cpus.size(); i++) {
+				if (isValidCpu(placement.cpus[i], placement.name)) {
+					mask |= static_cast<DWORD_PTR>(1) << placement.cpus[i];
+				}
+			}
+			if (mask == 0) {
+				applied = false;
+			}
+			else if (SetThreadAffinityMask(thread, mask) == 0) {
+				std::cout << "[TrackerKudan-OSVR] Could not set CPU affinity of " << placement.name << " (error " << GetLastError() << ")" << std::endl;
+				applied = false;
+			}
+		}
+
+		int priority = THREAD_PRIORITY_NORMAL;
+		bool setPriority = false;
+		if (placement.policy == SCHEDULING_FIFO || placement.policy == SCHEDULING_ROUND_ROBIN) {
+			priority = placement.hasPriority ? placement.priority : THREAD_PRIORITY_TIME_CRITICAL;
+			setPriority = true;
+		}
+		else if (placement.policy == SCHEDULING_NORMAL || placement.hasPriority) {
+			priority = placement.hasPriority ? placement.priority : THREAD_PRIORITY_NORMAL;
+			setPriority = true;
+		}
+		if (setPriority && !SetThreadPriority(thread, priority)) {
+			std::cout << "[TrackerKudan-OSVR] Could not set priority of " << placement.name << " (error " << GetLastError() << ")" << std::endl;
+			applied = false;
+		}
+
+		return applied;
+	}
+#else
+	bool applyThreadPlacement(const ThreadPlacement& placement) {
+		bool applied = true;
+		pthread_t thread = pthread_self();
+
+#ifdef __linux__
+		if (!placement.name.empty()) {
+			// Linux limits thread names to 15 characters
+			pthread_setname_np(thread, placement.name.substr(0, 15).c_str());
+		}
+
+		if (!placement.cpus.empty()) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			int valid = 0;
+			for (size_t i = 0; i < placement.cpus.size(); i++) {
+				if (isValidCpu(placement.cpus[i], placement.name)) {
+					CPU_SET(placement.cpus[i], &set);
+					valid++;
+				}
+			}
+			int error = valid > 0 ? pthread_setaffinity_np(thread, sizeof(set), &set) : 0;
+			if (valid == 0) {
+				applied = false;
+			}
+			else if (error != 0) {
+				std::cout << "[TrackerKudan-OSVR] Could not set CPU affinity of " << placement.name << " (" << strerror(error) << ")" << std::endl;
+				applied = false;
+			}
+		}
+#endif
+
+		if (placement.policy != SCHEDULING_DEFAULT || placement.hasPriority) {
+			int policy = SCHED_OTHER;
+			struct sched_param param;
+			pthread_getschedparam(thread, &policy, &param);
+
+			if (placement.policy == SCHEDULING_FIFO) {
+				policy = SCHED_FIFO;
+			}
+			else if (placement.policy == SCHEDULING_ROUND_ROBIN) {
+				policy = SCHED_RR;
+			}
+			else if (placement.policy == SCHEDULING_NORMAL) {
+				policy = SCHED_OTHER;
+			}
+
+			param.sched_priority = placement.hasPriority ? placement.priority : sched_get_priority_min(policy);
+			if (param.sched_priority < sched_get_priority_min(policy)) {
+				param.sched_priority = sched_get_priority_min(policy);
+			}
+			if (param.sched_priority > sched_get_priority_max(policy)) {
+				param.sched_priority = sched_get_priority_max(policy);
+			}
+
+			int error = pthread_setschedparam(thread, policy, &param);
+			if (error != 0) {
+				std::cout << "[TrackerKudan-OSVR] Could not set scheduling of " << placement.name << " (" << strerror(error) << "), keeping the default" << std::endl;
+				applied = false;
+			}
+		}
+
+		return applied;
+	}
+#endif
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	enum SchedulingPolicy {
+		SCHEDULING_DEFAULT,		// leave the thread as created
+		SCHEDULING_NORMAL,		// time sharing (SCHED_OTHER, normal Windows priority classes)
+		SCHEDULING_FIFO,		// real-time (SCHED_FIFO, time critical on Windows)
+		SCHEDULING_ROUND_ROBIN	// real-time (SCHED_RR, time critical on Windows)
+	};
+
+	/// Where and how one pipeline thread runs.
+	struct ThreadPlacement {
+		ThreadPlacement() : policy(SCHEDULING_DEFAULT), priority(0), hasPriority(false) {}
+
+		std::string name;
+		std::vector<int> cpus;	// empty to let the OS choose
+		SchedulingPolicy policy;
+		int priority;			// SCHED_* priority, or a THREAD_PRIORITY_* value on Windows
+		bool hasPriority;
+	};
+
+	/// Reads config["threads"][role], for instance
+	/// "threads": { "tracking": { "cpus": [2], "policy": "fifo", "priority": 10, "name": "kudan-track" } }.
+	/// Missing entries keep the OS defaults and the name defaults to "kudan-<role>".
+	ThreadPlacement getThreadPlacement(const Json::Value& config, const std::string& role);
+
+	/// Applies the placement to the calling thread. Settings that cannot be applied,
+	/// usually for lack of privileges, are reported and skipped. Returns false if any was skipped.
+	bool applyThreadPlacement(const ThreadPlacement& placement);
+
+}
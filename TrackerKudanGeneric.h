@@ -16,30 +16,36 @@
 #include <pxcsensemanager.h>
 //#include <pxcimage.h>
 
+#include "FrameSource.h"
+#include "CameraClock.h"
+#include "KudanPositionTracker.h"
+#include "SessionRecording.h"
+
 class TrackerKudanGeneric
 {
 public:
-	TrackerKudanGeneric(int cameraIndex);
+	TrackerKudanGeneric(com_samaust_trackerkudan_osvr::IFrameSource* frameSource, com_samaust_trackerkudan_osvr::MarkerCorrector* markerCorrector, com_samaust_trackerkudan_osvr::SessionRecorder* recorder, com_samaust_trackerkudan_osvr::TelemetryTap* telemetry, double processingScale);
 	~TrackerKudanGeneric();
 
 	void init();
-	OSVR_ReturnCode update(OSVR_PositionState* position, OSVR_OrientationState* orientation);
+	/// frameTime tells when the processed frame was captured, or that there was no new frame.
+	OSVR_ReturnCode update(OSVR_PositionState* position, OSVR_OrientationState* orientation, com_samaust_trackerkudan_osvr::FrameTime* frameTime);
+
+	unsigned int trackedFrames() const { return m_positionTracker.trackedFrames(); }
+	/// Applied before the next frame, see KudanPositionTracker::requestProcessingScale.
+	void setProcessingScale(double processingScale) { m_positionTracker.requestProcessingScale(processingScale); }
+	/// Applied before the next frame, see KudanPositionTracker::requestRoi.
+	void setRoi(double size, double lookahead) { m_positionTracker.requestRoi(size, lookahead); }
 
 private:
 	osvr::pluginkit::DeviceToken m_dev;
 	OSVR_TrackerDeviceInterface m_tracker;
 
-	cv::VideoCapture m_videoCapture;	
+	com_samaust_trackerkudan_osvr::IFrameSource* m_frameSource;
 	cv::Size m_frameSize;
 
-	int m_cameraIndex;
-
-	bool m_isRunningArbitrack;
-	bool m_doStartArbitrack;
-
-	KudanArbiTracker m_arbiTracker;
+	com_samaust_trackerkudan_osvr::KudanPositionTracker m_positionTracker;
 
-	float m_x_recenter;
-	float m_y_recenter;
-	float m_z_recenter;
+	// Optional, not owned
+	com_samaust_trackerkudan_osvr::SessionRecorder* m_recorder;
 };
\ No newline at end of file
@@ -14,19 +14,19 @@
 #include "TrackerKudanRS.h"
 
 
-/// Add your Kudan license key here
-const std::string kLicenseKey = "";
-
-
-TrackerKudanRS::TrackerKudanRS()
+TrackerKudanRS::TrackerKudanRS(com_samaust_trackerkudan_osvr::MarkerCorrector* markerCorrector, com_samaust_trackerkudan_osvr::SessionRecorder* recorder, com_samaust_trackerkudan_osvr::TelemetryTap* telemetry, double processingScale)
+	: m_positionTracker(markerCorrector, telemetry, processingScale)
 {
-	m_x_recenter = 0;
-	m_y_recenter = 0;
-	m_z_recenter = -2.0f;
+	m_positionTracker.enableRecenterHotkey();
+	m_recorder = recorder;
+	m_projection = NULL;
 }
 
 TrackerKudanRS::~TrackerKudanRS(void)
 {
+	if (m_projection) {
+		m_projection->Release();
+	}
 	// Clean RealSense Camera
 	m_pxcSenseManager->Release();
 }
@@ -51,54 +51,35 @@ void TrackerKudanRS::init() {
 		if (status < PXC_STATUS_NO_ERROR) {
 			std::cout << "[TrackerKudan-OSVR] Initialization Failed. Failed to enable Stream" << std::endl;
 		}
+		// Depth gives Arbitrack the distance of the scene, it tracks without it
+		bool depthEnabled = m_pxcSenseManager->EnableStream(PXCCapture::STREAM_TYPE_DEPTH, m_frameSize.width, m_frameSize.height, frameRate) >= PXC_STATUS_NO_ERROR;
+		if (!depthEnabled) {
+			std::cout << "[TrackerKudan-OSVR] Failed to enable the depth stream, starting Arbitrack at an assumed distance" << std::endl;
+		}
 
 		//Initialize the pipeline
 		status = m_pxcSenseManager->Init();
 		if (status < PXC_STATUS_NO_ERROR) {
 			std::cout << "[TrackerKudan-OSVR] Initialization Failed. SenseManager Init() failed." << std::endl;
 		}
+		else if (depthEnabled) {
+			m_projection = m_pxcSenseManager->QueryCaptureManager()->QueryDevice()->CreateProjection();
+		}
 
-		// Set up the intrinsics, by setting the size, and using the function to guess the intrinsics (if they are known, use setIntrinsics())
-		KudanCameraParameters cameraParameters;
-		cameraParameters.setSize(m_frameSize.width, m_frameSize.height);
-		cameraParameters.guessIntrinsics();
-
-		// Retrieve the camera calibration matrix from the parameters, because it is needed for drawing:
-		KudanMatrix3 K = cameraParameters.getMatrix();
-
-		// Create the tracker:
-		KudanImageTracker tracker;
-
-		// Set your API key here
-		tracker.setApiKey(kLicenseKey);
-
-		// set global tracker properties:
-		tracker.setMaximumSimultaneousTracking(2);
-
-		// The tracker needs to know the intrinsics:
-		tracker.setCameraParameters(cameraParameters);
-
-		/* Note: it is NOT possible to create trackables without initialising them. This will not be allowed:
-		std::shared_ptr<KudanImageTrackable> blankTrackable = std::make_shared<KudanImageTrackable>();
-		*/
-
-		// Also want to be able to run arbitrack
-		m_arbiTracker.setApiKey(kLicenseKey);
-		m_arbiTracker.setCameraParameters(cameraParameters);
-
-		m_isRunningArbitrack = false;
-		m_doStartArbitrack = true;
-
-		std::cout << "[TrackerKudan-OSVR] Tracker initialized" << std::endl;
+		m_positionTracker.init(m_frameSize);
 	}
 	catch (KudanException &e) {
 		printf("[TrackerKudan-OSVR] Tracker initialization failed. Caught exception: %s \n", e.what());
 	}
 }
 
-OSVR_ReturnCode TrackerKudanRS::update(OSVR_PositionState* position, OSVR_OrientationState* orientation) {
-	// Acquire frame from the camera
+OSVR_ReturnCode TrackerKudanRS::update(OSVR_PositionState* position, OSVR_OrientationState* orientation, com_samaust_trackerkudan_osvr::FrameTime* frameTime) {
+	frameTime->valid = false;
+
+	// Acquire frame from the camera, blocks until it arrived
 	m_pxcSenseManager->AcquireFrame();
+	OSVR_TimeValue arrivalTime;
+	osvrTimeValueGetNow(&arrivalTime);
 	PXCCapture::Sample *sample = m_pxcSenseManager->QuerySample();
 
 	if (!sample) {
@@ -135,7 +116,6 @@ OSVR_ReturnCode TrackerKudanRS::update(OSVR_PositionState* position, OSVR_Orient
 	//int width = sample->color->QueryInfo().width;
 	//int height = sample->color->QueryInfo().height;
 	frameColor = cv::Mat(cv::Size(m_frameSize.width, m_frameSize.height), CV_8UC3, data.planes[0], data.pitches[0]);
-	sample->color->ReleaseAccess(&data);
 
 	//if (frameColor.type() != CV_8UC3)
 	//{
@@ -153,6 +133,8 @@ OSVR_ReturnCode TrackerKudanRS::update(OSVR_PositionState* position, OSVR_Orient
 	// Tracker requires greyscale data:
 	cv::Mat frameGrey = cv::Mat::zeros(m_frameSize, CV_8UC1);
 	cv::cvtColor(frameColor, frameGrey, CV_BGR2GRAY);
+	// frameColor points into the RealSense image, keep it accessible until converted
+	sample->color->ReleaseAccess(&data);
 
 	if (!frameGrey.data) {
 		// Error
@@ -166,72 +148,40 @@ OSVR_ReturnCode TrackerKudanRS::update(OSVR_PositionState* position, OSVR_Orient
 		return OSVR_RETURN_SUCCESS;
 	} 
 
-	uchar *imageData = frameGrey.data;
-	int imageWidth = frameGrey.size().width;
-	int imageHeight = frameGrey.size().height;
-
-	if (m_isRunningArbitrack) {
-		KudanQuaternion orientationQuaternion = KudanQuaternion(orientation->data[1], orientation->data[2], orientation->data[3], orientation->data[0]);
-
-		m_arbiTracker.setSensedOrientation(orientationQuaternion);
-
-		// * TRACK *
-		m_arbiTracker.processFrame(imageData, imageWidth, imageHeight, frameGrey.channels(), 0 /*padding*/, false);
-
-		KudanVector3 arbitrackPosition = m_arbiTracker.getPosition();
-		//KudanQuaternion arbitrackOrientation = m_arbiTracker.getOrientation();
-
-		// Recenter if CTRL + F12 is pressed
-		if (GetAsyncKeyState(VK_CONTROL) & 0x8000)
-		{
-			if (GetAsyncKeyState(VK_F12) & 0x8000)
-			{
-				m_x_recenter = arbitrackPosition.x / 100.0f;
-				m_y_recenter = -arbitrackPosition.y / 100.0f;
-				m_z_recenter = -arbitrackPosition.z / 100.0f;
-			}
+	// Camera clock, in 100 ns units
+	uint64_t captureTimeUs = static_cast<uint64_t>(sample->color->QueryTimeStamp() / 10);
+
+	// Depth in millimetres, seen from the colour camera. Mapped only for the frames that use it.
+	cv::Mat depth;
+	PXCImage* depthMapped = NULL;
+	PXCImage::ImageData depthData;
+	if (m_projection && sample->depth && (m_recorder || m_positionTracker.wantsDepth())) {
+		depthMapped = m_projection->CreateDepthImageMappedToColor(sample->depth, sample->color);
+		if (depthMapped && depthMapped->AcquireAccess(PXCImage::ACCESS_READ, PXCImage::PIXEL_FORMAT_DEPTH, &depthData) >= PXC_STATUS_NO_ERROR) {
+			depth = cv::Mat(m_frameSize, CV_16UC1, depthData.planes[0], depthData.pitches[0]);
 		}
+	}
 
-		// Return position
-		// Convert to m
-		position->data[0] = -arbitrackPosition.x / 100.0f + m_x_recenter;
-		position->data[1] = arbitrackPosition.y / 100.0f + m_y_recenter;
-		position->data[2] = arbitrackPosition.z / 100.0f + m_z_recenter;
+	if (m_recorder) {
+		m_recorder->recordFrame(frameGrey, *orientation, captureTimeUs, depth);
 	}
-	else {
-		// If arbitrack needs to be started, but has not been (i.e. no trackables) then do so now, from a pose in front of the camera
-		if (m_doStartArbitrack) {
-			m_isRunningArbitrack = true;
-
-			// Start via a position and quaternion:
-			//                    KudanVector3 startPosition(0,0,200); // in front of the camera
-			//                    KudanQuaternion startOrientation(1,0,0,0); // without rotation
-			//                    m_arbiTracker.start(startPosition, startOrientation);
-
-			// Start via a 4x4 matrix:
-			// Set to identity:
-			KudanMatrix4 transform;
-			for (int i = 0; i < 4; i++) {
-				transform(i, i) = 1.0;
-			}
-			// z coordinate of T, in third column
-			transform(2, 3) = 200;
-
-			m_arbiTracker.start(transform);
-
-			printf("[TrackerKudan-OSVR] Starting Arbitrack from here \n");
-			m_doStartArbitrack = false;
-		}
 
-		// Return position
-		position->data[0] = 0;
-		position->data[1] = 0;
-		position->data[2] = 0;
+	m_positionTracker.processFrame(frameGrey, *orientation, position, depth);
+
+	if (!depth.empty()) {
+		depthMapped->ReleaseAccess(&depthData);
 	}
-	
+	if (depthMapped) {
+		depthMapped->Release();
+	}
+
 	//Release the memory from the frame
 	m_pxcSenseManager->ReleaseFrame();
 
+	frameTime->valid = true;
+	frameTime->captureTimeUs = captureTimeUs;
+	frameTime->arrivalTime = arrivalTime;
+
 	//std::cout << "[TrackerKudan-OSVR] position [x, y, z] = " << position->data[0] << ", " << position->data[1] << ", " << position->data[2] << std::endl;
 	
 	return OSVR_RETURN_SUCCESS;
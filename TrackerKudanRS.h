@@ -14,30 +14,40 @@
 
 // RealSense
 #include <pxcsensemanager.h>
+#include <pxcprojection.h>
 //#include <pxcimage.h>
 
+#include "CameraClock.h"
+#include "KudanPositionTracker.h"
+#include "SessionRecording.h"
+
 class TrackerKudanRS
 {
 public:
-	TrackerKudanRS();
+	TrackerKudanRS(com_samaust_trackerkudan_osvr::MarkerCorrector* markerCorrector, com_samaust_trackerkudan_osvr::SessionRecorder* recorder, com_samaust_trackerkudan_osvr::TelemetryTap* telemetry, double processingScale);
 	~TrackerKudanRS();
 
 	void init();
-	OSVR_ReturnCode update(OSVR_PositionState* position, OSVR_OrientationState* orientation);
+	/// frameTime tells when the processed frame was captured, or that there was no new frame.
+	OSVR_ReturnCode update(OSVR_PositionState* position, OSVR_OrientationState* orientation, com_samaust_trackerkudan_osvr::FrameTime* frameTime);
+
+	unsigned int trackedFrames() const { return m_positionTracker.trackedFrames(); }
+	/// Applied before the next frame, see KudanPositionTracker::requestProcessingScale.
+	void setProcessingScale(double processingScale) { m_positionTracker.requestProcessingScale(processingScale); }
+	/// Applied before the next frame, see KudanPositionTracker::requestRoi.
+	void setRoi(double size, double lookahead) { m_positionTracker.requestRoi(size, lookahead); }
 
 private:
 	osvr::pluginkit::DeviceToken m_dev;
 	OSVR_TrackerDeviceInterface m_tracker;
 
 	PXCSenseManager *m_pxcSenseManager;
+	// Maps the depth images to the colour frames, NULL without the depth stream
+	PXCProjection *m_projection;
 	cv::Size m_frameSize;
 
-	bool m_isRunningArbitrack;
-	bool m_doStartArbitrack;
-
-	KudanArbiTracker m_arbiTracker;
+	com_samaust_trackerkudan_osvr::KudanPositionTracker m_positionTracker;
 
-	float m_x_recenter;
-	float m_y_recenter;
-	float m_z_recenter;
+	// Optional, not owned
+	com_samaust_trackerkudan_osvr::SessionRecorder* m_recorder;
 };
\ No newline at end of file
@@ -0,0 +1,273 @@
+// Simulated fusion devices sharing one TrackingScheduler, against tracking every device inline
+// on the update thread. Reports tracked frames per second, dropped frames and the latency from
+// frame arrival to tracked position, for every device count and worker count asked for.
+//
+// Devices replay the given sessions (see "recordSession") through Kudan, one session each in turn,
+// or without sessions burn a synthetic frame cost. Device 0 is the HMD and runs at high priority.
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KudanPositionTracker.h"
+#include "SessionRecording.h"
+#include "TrackingScheduler.h"
+
+using namespace com_samaust_trackerkudan_osvr;
+
+namespace {
+
+	typedef std::chrono::steady_clock Clock;
+
+	void usage() {
+		std::cout << "Usage: trackerkudan_load_test [options] [<session> ...]" << std::endl
+			<< "  --devices <list>      device counts, comma separated (default 1,2,4,8)" << std::endl
+			<< "  --threads <list>      worker counts, 0 for one per core (default 1,2,4,0)" << std::endl
+			<< "  --fps <fps>           frame rate of every device (default 60)" << std::endl
+			<< "  --seconds <s>         duration of every run (default 5)" << std::endl
+			<< "  --work <us>           synthetic frame cost without sessions (default 4000)" << std::endl;
+	}
+
+	std::vector<int> parseList(const std::string& text) {
+		std::vector<int> values;
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ',')) {
+			values.push_back(std::atoi(item.c_str()));
+		}
+		return values;
+	}
+
+	// Fixed amount of computation rather than a wall clock spin, so that workers sharing a core
+	// do not all appear to finish on time
+	double g_iterationsPerUs = 0;
+
+	double burn(long long iterations) {
+		double sink = 0;
+		for (long long i = 0; i < iterations; i++) {
+			sink = sink * 0.999 + i * 0.5;
+		}
+		return sink;
+	}
+
+	void calibrate() {
+		long long iterations = 1000000;
+		volatile double sink = burn(iterations);
+		Clock::time_point start = Clock::now();
+		sink = sink + burn(iterations * 20);
+		g_iterationsPerUs = iterations * 20 / std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+	}
+
+	struct Device {
+		Device() : dropped(0), records(NULL), next(0), tracker(NULL, NULL, 1.0) {}
+
+		std::unique_ptr<TrackingScheduler::Lane> lane;
+		std::vector<double> latencies;	// ms
+		size_t dropped;
+
+		// Replay of one session, NULL for synthetic frames
+		std::vector<SessionRecord>* records;
+		size_t next;
+		KudanPositionTracker tracker;
+	};
+
+	// One frame of the device, as its update callback would track it
+	void trackFrame(Device& device, int workUs) {
+		if (!device.records) {
+			volatile double sink = burn(static_cast<long long>(workUs * g_iterationsPerUs));
+			(void)sink;
+			return;
+		}
+
+		// The session starts over with Arbitrack, rather than jumping back within one run
+		size_t index = device.next++ % device.records->size();
+		SessionRecord& record = (*device.records)[index];
+		if (index == 0) {
+			device.tracker.init(cv::Size(record.header.width, record.header.height));
+		}
+		OSVR_PositionState position;
+		device.tracker.processFrame(record.frameGrey(), record.orientation(), &position, record.depthMap());
+	}
+
+	double percentile(const std::vector<double>& sorted, double fraction) {
+		if (sorted.empty()) {
+			return 0;
+		}
+		return sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * fraction))];
+	}
+
+	// threads < 0 tracks inline on the calling thread
+	void run(int devices, int threads, double fps, double seconds, int workUs, std::vector<std::vector<SessionRecord> >& sessions) {
+		std::shared_ptr<TrackingScheduler> scheduler;
+		if (threads >= 0) {
+			ThreadPlacement placement;
+			placement.name = "kudan-load";
+			scheduler = std::make_shared<TrackingScheduler>(threads, placement);
+		}
+
+		std::vector<std::unique_ptr<Device> > pool;
+		for (int d = 0; d < devices; d++) {
+			pool.push_back(std::unique_ptr<Device>(new Device()));
+			pool[d]->records = sessions.empty() ? NULL : &sessions[d % sessions.size()];
+			if (scheduler) {
+				pool[d]->lane = scheduler->createLane(d == 0);
+			}
+		}
+
+		// Arrivals of the devices are spread evenly over the frame period
+		Clock::duration period = std::chrono::microseconds(static_cast<long long>(1e6 / fps));
+		int frames = static_cast<int>(seconds * fps);
+		Clock::time_point start = Clock::now() + period;
+
+		for (int f = 0; f < frames; f++) {
+			for (int d = 0; d < devices; d++) {
+				Device& device = *pool[d];
+				Clock::time_point arrival = start + f * period + d * period / devices;
+				std::this_thread::sleep_until(arrival);
+
+				if (!scheduler) {
+					// Inline, a newer frame of the device has already replaced this one
+					if (Clock::now() > arrival + period) {
+						device.dropped++;
+						continue;
+					}
+					trackFrame(device, workUs);
+					device.latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - arrival).count());
+					continue;
+				}
+
+				// Like ScheduledKudanPosition, a frame is submitted only once the previous one is done
+				if (!device.lane->idle()) {
+					device.dropped++;
+					continue;
+				}
+				Device* target = &device;
+				device.lane->submit([target, arrival, workUs] {
+					trackFrame(*target, workUs);
+					target->latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - arrival).count());
+				});
+			}
+		}
+		for (int d = 0; d < devices && scheduler; d++) {
+			pool[d]->lane->waitIdle();
+		}
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+		std::vector<double> all;
+		size_t dropped = 0;
+		for (int d = 0; d < devices; d++) {
+			all.insert(all.end(), pool[d]->latencies.begin(), pool[d]->latencies.end());
+			dropped += pool[d]->dropped;
+		}
+		std::sort(all.begin(), all.end());
+		std::vector<double> hmd = pool[0]->latencies;
+		std::sort(hmd.begin(), hmd.end());
+
+		std::cout << std::setw(7) << devices << std::setw(9) << (scheduler ? std::to_string(scheduler->size()) : std::string("inline"))
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(10) << all.size() / elapsed
+			<< std::setw(9) << 100.0 * dropped / (devices * frames)
+			<< std::setw(8) << percentile(all, 0.5)
+			<< std::setw(8) << percentile(all, 0.9)
+			<< std::setw(8) << percentile(all, 0.99)
+			<< std::setw(10) << percentile(hmd, 0.99) << std::endl;
+	}
+
+}
+
+int main(int argc, char** argv) {
+	std::vector<int> deviceCounts = parseList("1,2,4,8");
+	std::vector<int> threadCounts = parseList("1,2,4,0");
+	double fps = 60;
+	double seconds = 5;
+	int workUs = 4000;
+	std::vector<std::string> sessions;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--devices" && i + 1 < argc) {
+			deviceCounts = parseList(argv[++i]);
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			threadCounts = parseList(argv[++i]);
+		}
+		else if (arg == "--fps" && i + 1 < argc) {
+			fps = std::atof(argv[++i]);
+		}
+		else if (arg == "--seconds" && i + 1 < argc) {
+			seconds = std::atof(argv[++i]);
+		}
+		else if (arg == "--work" && i + 1 < argc) {
+			workUs = std::atoi(argv[++i]);
+		}
+		else if (arg.compare(0, 2, "--") == 0) {
+			usage();
+			return 1;
+		}
+		else {
+			sessions.push_back(arg);
+		}
+	}
+
+	for (size_t i = 0; i < deviceCounts.size(); i++) {
+		if (deviceCounts[i] < 1) {
+			std::cerr << "Device counts must be at least 1" << std::endl;
+			return 1;
+		}
+	}
+	for (size_t i = 0; i < threadCounts.size(); i++) {
+		if (threadCounts[i] < 0) {
+			std::cerr << "Worker counts must be 0 (one per core) or more" << std::endl;
+			return 1;
+		}
+	}
+	if (deviceCounts.empty() || fps <= 0 || seconds <= 0 || workUs < 0) {
+		usage();
+		return 1;
+	}
+
+	// Device d replays session d modulo the session count, each loaded once
+	std::vector<std::vector<SessionRecord> > records(sessions.size());
+	for (size_t s = 0; s < sessions.size(); s++) {
+		SessionReader reader;
+		if (!reader.open(sessions[s])) {
+			std::cerr << "Could not open session " << sessions[s] << std::endl;
+			return 1;
+		}
+		SessionRecord record;
+		while (reader.next(&record)) {
+			records[s].push_back(record);
+		}
+		if (records[s].empty()) {
+			std::cerr << "Session " << sessions[s] << " has no frame" << std::endl;
+			return 1;
+		}
+		std::cout << records[s].size() << " frames in " << sessions[s] << std::endl;
+	}
+	if (!sessions.empty()) {
+		std::cout << "Devices replay the sessions in turn" << std::endl;
+	}
+	else {
+		calibrate();
+		std::cout << "Synthetic frames of " << workUs << " us" << std::endl;
+	}
+
+	std::cout << "devices  workers  frames/s  drop(%)  p50 ms  p90 ms  p99 ms  hmd p99" << std::endl;
+	for (size_t d = 0; d < deviceCounts.size(); d++) {
+		run(deviceCounts[d], -1, fps, seconds, workUs, records);
+		for (size_t t = 0; t < threadCounts.size(); t++) {
+			run(deviceCounts[d], threadCounts[t], fps, seconds, workUs, records);
+		}
+	}
+
+	return 0;
+}
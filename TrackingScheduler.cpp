@@ -0,0 +1,77 @@
+#include "TrackingScheduler.h"
+
+#include <iostream>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	TrackingScheduler::Lane::Lane(WorkStealingPool* pool, bool highPriority) {
+		m_pool = pool;
+		m_highPriority = highPriority;
+		m_scheduled = false;
+	}
+
+	void TrackingScheduler::Lane::submit(WorkStealingPool::Job job) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+		if (!m_scheduled) {
+			m_scheduled = true;
+			m_pool->submit([this] { runNext(); }, m_highPriority);
+		}
+	}
+
+	bool TrackingScheduler::Lane::idle() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return !m_scheduled;
+	}
+
+	void TrackingScheduler::Lane::waitIdle() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this] { return !m_scheduled; });
+	}
+
+	void TrackingScheduler::Lane::runNext() {
+		WorkStealingPool::Job job;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		job();
+
+		// One job per pool job so that lanes take turns. Submitted from the worker, the next
+		// job of the lane stays on its deque, with the lane's data in its cache.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_jobs.empty()) {
+			m_scheduled = false;
+			m_idle.notify_all();
+		}
+		else {
+			m_pool->submit([this] { runNext(); }, m_highPriority);
+		}
+	}
+
+	// Frames are tracked in arrival order, a newest first pool would let old frames of busy devices wait behind new ones
+	TrackingScheduler::TrackingScheduler(unsigned int threads, ThreadPlacement placement) : m_pool(threads, placement, true) {
+	}
+
+	std::shared_ptr<TrackingScheduler> TrackingScheduler::getShared(const Json::Value& config) {
+		static std::mutex mutex;
+		static std::weak_ptr<TrackingScheduler> shared;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		std::shared_ptr<TrackingScheduler> scheduler = shared.lock();
+		if (!scheduler) {
+			unsigned int threads = config["scheduler"].get("threads", 0).asUInt();
+			scheduler = std::make_shared<TrackingScheduler>(threads, getThreadPlacement(config, "scheduler"));
+			shared = scheduler;
+			std::cout << "[TrackerKudan-OSVR] Tracking scheduler started with " << scheduler->size() << " workers" << std::endl;
+		}
+		return scheduler;
+	}
+
+	std::unique_ptr<TrackingScheduler::Lane> TrackingScheduler::createLane(bool highPriority) {
+		return std::unique_ptr<Lane>(new Lane(&m_pool, highPriority));
+	}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <json/json.h>
+
+#include "WorkStealingPool.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Process wide pool the fusion devices run their per frame tracking jobs on, instead of
+	/// their own update callback. Each device submits through a lane.
+	class TrackingScheduler {
+	public:
+		/// Jobs of one lane run one at a time, in submission order, on any worker. Lanes of high
+		/// priority (the HMD) get the next free worker before the others.
+		class Lane {
+		public:
+			Lane(WorkStealingPool* pool, bool highPriority);
+
+			void submit(WorkStealingPool::Job job);
+
+			/// No job queued or running.
+			bool idle();
+
+			/// Blocks until idle, to call before destroying what the jobs use.
+			void waitIdle();
+
+		private:
+			void runNext();
+
+			WorkStealingPool* m_pool;
+			bool m_highPriority;
+
+			std::mutex m_mutex;
+			std::condition_variable m_idle;
+			std::deque<WorkStealingPool::Job> m_jobs;
+			bool m_scheduled;	// a runNext is queued or running on the pool
+		};
+
+		/// threads 0 uses one worker per core.
+		TrackingScheduler(unsigned int threads, ThreadPlacement placement);
+
+		/// The scheduler shared by every device of the process, created by the first device with
+		/// its config["scheduler"]["threads"] and "scheduler" thread placement. It is destroyed
+		/// with the last device holding it.
+		static std::shared_ptr<TrackingScheduler> getShared(const Json::Value& config);
+
+		/// The lane must be idle when released and must not outlive the scheduler.
+		std::unique_ptr<Lane> createLane(bool highPriority);
+
+		unsigned int size() const { return m_pool.size(); }
+
+	private:
+		WorkStealingPool m_pool;
+	};
+
+}
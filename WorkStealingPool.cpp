@@ -0,0 +1,144 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace com_samaust_trackerkudan_osvr {
+
+	// Worker the calling thread belongs to, if any
+	static thread_local WorkStealingPool* t_pool = NULL;
+	static thread_local unsigned int t_workerIndex = 0;
+
+	WorkStealingPool::WorkStealingPool(unsigned int threads, ThreadPlacement placement, bool oldestFirst) : m_nextWorker(0), m_highPriorityQueued(0) {
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		m_placement = placement;
+		m_oldestFirst = oldestFirst;
+		m_queued = 0;
+		m_pending = 0;
+		m_stop = false;
+
+		for (unsigned int i = 0; i < threads; i++) {
+			m_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+		}
+		for (unsigned int i = 0; i < threads; i++) {
+			m_threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+		}
+	}
+
+	WorkStealingPool::~WorkStealingPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_jobQueued.notify_all();
+		for (size_t i = 0; i < m_threads.size(); i++) {
+			m_threads[i].join();
+		}
+	}
+
+	void WorkStealingPool::submit(Job job, bool highPriority) {
+		unsigned int target = t_pool == this ? t_workerIndex : m_nextWorker++ % size();
+
+		{
+			// m_mutex is held so that a thief never sees the job before it is counted
+			std::lock_guard<std::mutex> lock(m_mutex);
+			{
+				std::lock_guard<std::mutex> workerLock(m_workers[target]->mutex);
+				if (highPriority) {
+					m_workers[target]->highPriorityJobs.push_back(job);
+					m_highPriorityQueued++;
+				}
+				else {
+					m_workers[target]->jobs.push_back(job);
+				}
+			}
+			m_queued++;
+			m_pending++;
+		}
+		m_jobQueued.notify_one();
+	}
+
+	void WorkStealingPool::wait() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_allDone.wait(lock, [this] { return m_pending == 0; });
+	}
+
+	bool WorkStealingPool::takeJob(unsigned int index, Job& job) {
+		bool found = false;
+		if (m_highPriorityQueued > 0 && takeJob(index, &Worker::highPriorityJobs, job)) {
+			m_highPriorityQueued--;
+			found = true;
+		}
+		if (!found) {
+			found = takeJob(index, &Worker::jobs, job);
+		}
+
+		if (found) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queued--;
+		}
+		return found;
+	}
+
+	bool WorkStealingPool::takeJob(unsigned int index, std::deque<Job> Worker::* jobs, Job& job) {
+		{
+			// Own deque first, newest job unless oldest first: its data is most likely still in cache
+			std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+			std::deque<Job>& own = (*m_workers[index]).*jobs;
+			if (!own.empty() && m_oldestFirst) {
+				job = own.front();
+				own.pop_front();
+				return true;
+			}
+			if (!own.empty()) {
+				job = own.back();
+				own.pop_back();
+				return true;
+			}
+		}
+		for (unsigned int i = 1; i < size(); i++) {
+			Worker& victim = *m_workers[(index + i) % size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			std::deque<Job>& stolen = victim.*jobs;
+			if (!stolen.empty()) {
+				job = stolen.front();
+				stolen.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkStealingPool::workerLoop(unsigned int index) {
+		ThreadPlacement placement = m_placement;
+		std::ostringstream name;
+		name << placement.name << "-" << index;
+		placement.name = name.str();
+		applyThreadPlacement(placement);
+
+		t_pool = this;
+		t_workerIndex = index;
+
+		while (true) {
+			Job job;
+			if (takeJob(index, job)) {
+				job();
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (--m_pending == 0) {
+					m_allDone.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobQueued.wait(lock, [this] { return m_stop || m_queued > 0; });
+			if (m_stop && m_queued == 0) {
+				break;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ThreadPlacement.h"
+
+namespace com_samaust_trackerkudan_osvr {
+
+	/// Fixed set of worker threads, each with its own job deques. A worker runs its newest job
+	/// first and, when its deques are empty, steals the oldest job of another worker. High
+	/// priority jobs of every worker are taken before any normal one.
+	class WorkStealingPool {
+	public:
+		typedef std::function<void()> Job;
+
+		/// threads 0 uses one worker per core. Every worker gets the placement, named <name>-<index>.
+		/// oldestFirst makes workers run their own jobs in submission order too, fairer to jobs
+		/// that wait for a deadline than the cache friendly newest first.
+		WorkStealingPool(unsigned int threads, ThreadPlacement placement, bool oldestFirst = false);
+		~WorkStealingPool();
+
+		/// Jobs submitted from a worker go to its own deque, others are spread over the workers.
+		void submit(Job job, bool highPriority = false);
+
+		/// Blocks until every submitted job has completed.
+		void wait();
+
+		unsigned int size() const { return static_cast<unsigned int>(m_workers.size()); }
+
+	private:
+		struct Worker {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+			std::deque<Job> highPriorityJobs;
+		};
+
+		void workerLoop(unsigned int index);
+		bool takeJob(unsigned int index, Job& job);
+		bool takeJob(unsigned int index, std::deque<Job> Worker::* jobs, Job& job);
+
+		std::vector<std::unique_ptr<Worker> > m_workers;
+		std::vector<std::thread> m_threads;
+		ThreadPlacement m_placement;
+		bool m_oldestFirst;
+		std::atomic<unsigned int> m_nextWorker;
+		std::atomic<unsigned int> m_highPriorityQueued;	// lets takeJob skip the high priority deques
+
+		std::mutex m_mutex;
+		std::condition_variable m_jobQueued;
+		std::condition_variable m_allDone;
+		size_t m_queued;	// jobs in the deques, guarded by m_mutex
+		size_t m_pending;	// jobs not completed yet, guarded by m_mutex
+		bool m_stop;
+	};
+
+}
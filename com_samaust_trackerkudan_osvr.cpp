@@ -1,136 +1,340 @@
 #include "stdafx.h"
+#include <atomic>
 #include <iostream>
 
 #include "TrackerKudanRS.h"
 #include "TrackerKudanGeneric.h"
+#include "ThreadPlacement.h"
+#include "CameraClock.h"
+#include "FusionParameters.h"
+#include "FusionConfig.h"
+#include "FusionPipeline.h"
+#include "ParameterReloader.h"
+#include "SessionRecording.h"
+#include "TrackingScheduler.h"
 
 // Anonymous namespace to avoid symbol collision
 namespace com_samaust_trackerkudan_osvr {
 
-	class TrackerKudanFusion {
+	// Single readers take one path, combined readers an object with one path per axis
+	template <class Reader> Reader* createReader(OSVR_ClientContext ctx, const Json::Value& config);
+	template <> SinglePositionReader* createReader<SinglePositionReader>(OSVR_ClientContext ctx, const Json::Value& config) {
+		return new SinglePositionReader(ctx, config.asString());
+	}
+	template <> CombinedPositionReader* createReader<CombinedPositionReader>(OSVR_ClientContext ctx, const Json::Value& config) {
+		return new CombinedPositionReader(ctx, config);
+	}
+	template <> SingleOrientationReader* createReader<SingleOrientationReader>(OSVR_ClientContext ctx, const Json::Value& config) {
+		return new SingleOrientationReader(ctx, config.asString());
+	}
+	template <> CombinedOrientationReader* createReader<CombinedOrientationReader>(OSVR_ClientContext ctx, const Json::Value& config) {
+		return new CombinedOrientationReader(ctx, config);
+	}
+
+	template <class Tracker> Tracker* createTracker(const FusionContext& context, MarkerCorrector* markerCorrector, SessionRecorder* recorder);
+	template <> TrackerKudanRS* createTracker<TrackerKudanRS>(const FusionContext& context, MarkerCorrector* markerCorrector, SessionRecorder* recorder) {
+		return new TrackerKudanRS(markerCorrector, recorder, context.telemetry.get(), context.parameters.processingScale);
+	}
+	template <> TrackerKudanGeneric* createTracker<TrackerKudanGeneric>(const FusionContext& context, MarkerCorrector* markerCorrector, SessionRecorder* recorder) {
+		return new TrackerKudanGeneric(FrameSourceFactory::getSource(context.config), markerCorrector, recorder, context.telemetry.get(), context.parameters.processingScale);
+	}
+
+	/// Orientation of an OSVR interface. Readers are final, so update is not a virtual call.
+	template <class Reader>
+	class ReaderOrientation {
 	public:
-		TrackerKudanFusion(OSVR_PluginRegContext ctx, Json::Value config) {
-			osvrPose3SetIdentity(&m_state);
+		explicit ReaderOrientation(FusionContext& context) {
+			m_reader = createReader<Reader>(context.clientContext, context.config["orientation"]);
+		}
+		~ReaderOrientation() { delete m_reader; }
 
-			m_useTimestamp = config.isMember("timestamp");
-			m_usePositionTimestamp = m_useTimestamp && config["timestamp"].asString().compare("position") == 0;
-			m_useKudanPositionOnly = config["position"].asString().compare("") == 0;
-			m_cameraType = config["cameraType"].asInt();
-			m_cameraIndex = config["cameraIndex"].asInt();
-				
+		void update(OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+			m_reader->update(orientation, timeValue);
+		}
 
-			if ((m_useOffset = config.isMember("offsetFromRotationCenter"))) {
-				osvrVec3Zero(&m_offset);
+	private:
+		Reader* m_reader;
+	};
 
-				if (config["offsetFromRotationCenter"].isMember("x")) {
-					osvrVec3SetX(&m_offset, config["offsetFromRotationCenter"]["x"].asDouble());
-				}
-				if (config["offsetFromRotationCenter"].isMember("y")) {
-					osvrVec3SetY(&m_offset, config["offsetFromRotationCenter"]["y"].asDouble());
-				}
-				if (config["offsetFromRotationCenter"].isMember("z")) {
-					osvrVec3SetZ(&m_offset, config["offsetFromRotationCenter"]["z"].asDouble());
+	/// Position of an OSVR interface, new when the interface reports a state.
+	template <class Reader>
+	class ReaderPosition {
+	public:
+		explicit ReaderPosition(FusionContext& context) {
+			m_reader = createReader<Reader>(context.clientContext, context.config["position"]);
+		}
+		~ReaderPosition() { delete m_reader; }
+
+		bool update(OSVR_PositionState* position, OSVR_OrientationState*, OSVR_TimeValue* timeValue) {
+			return m_reader->update(position, timeValue) == OSVR_RETURN_SUCCESS;
+		}
+
+		void setParameters(const FusionParameters&) {}
+
+	private:
+		Reader* m_reader;
+	};
+
+	/// Position tracked by Kudan, new when the tracker processed a frame, stamped with the capture
+	/// time of the frame. Owns the optional marker corrector and session recorder.
+	template <class Tracker>
+	class KudanPosition {
+	public:
+		explicit KudanPosition(FusionContext& context) : m_cameraClock(context.config["cameraClock"]) {
+			m_telemetry = context.telemetry.get();
+			m_lastClockPublish = 0;
+			m_markerCorrector = NULL;
+			m_recorder = NULL;
+			m_referenceReader = NULL;
+			m_trackedFrames = 0;
+
+			if (context.config.isMember("markers")) {
+				m_markerCorrector = new MarkerCorrector(context.config["markers"], getThreadPlacement(context.config, "marker"));
+			}
+
+			// Sessions replayed by trackerkudan_sweep, optionally with a reference position to score against
+			if (context.config.isMember("recordSession")) {
+				m_recorder = new SessionRecorder(context.config["recordSession"].asString(), getThreadPlacement(context.config, "recorder"));
+				if (context.config.isMember("recordReference")) {
+					m_referenceReader = PositionReaderFactory::getReader(context.clientContext, context.config["recordReference"]);
 				}
 			}
 
-			OSVR_DeviceInitOptions opts = osvrDeviceCreateInitOptions(ctx);
+			m_tracker = createTracker<Tracker>(context, m_markerCorrector, m_recorder);
+			m_tracker->setRoi(context.parameters.roiSize, context.parameters.roiLookahead);
+			m_tracker->init();
+		}
+		~KudanPosition() { delete m_tracker; delete m_markerCorrector; delete m_recorder; delete m_referenceReader; }
 
-			osvrDeviceTrackerConfigure(opts, &m_tracker);
+		bool update(OSVR_PositionState* position, OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+			updateReference();
+			return track(position, orientation, timeValue);
+		}
 
-			OSVR_DeviceToken token;
-			osvrAnalysisSyncInit(ctx, config["name"].asCString(), opts, &token, &m_ctx);
+		void setParameters(const FusionParameters& parameters) {
+			m_tracker->setProcessingScale(parameters.processingScale);
+			m_tracker->setRoi(parameters.roiSize, parameters.roiLookahead);
+		}
 
-			m_dev = new osvr::pluginkit::DeviceToken(token);
+		/// Reads the OSVR reference position, on the thread of the client context.
+		void updateReference() {
+			if (m_referenceReader) {
+				OSVR_PositionState reference;
+				OSVR_TimeValue timeValueReference;
+				if (m_referenceReader->update(&reference, &timeValueReference) == OSVR_RETURN_SUCCESS) {
+					m_recorder->setReference(reference);
+				}
+			}
+		}
 
-			m_orientationReader = OrientationReaderFactory::getReader(m_ctx, config["orientation"]);
-			if (m_orientationReader == NULL) {
-				std::cout << "[TrackerKudan-OSVR] Fusion Device: Orientation Reader not created" << std::endl;
+		/// Processes the latest frame, on any thread but one at a time. timeValue is only set with a new position.
+		bool track(OSVR_PositionState* position, OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+			FrameTime frameTime;
+			m_tracker->update(position, orientation, &frameTime);
+			if (!frameTime.valid) {
+				return false;
 			}
+			// Every frame feeds the clock estimate, tracked or not
+			OSVR_TimeValue captureTime = m_cameraClock.map(frameTime);
+			publishCameraClock(frameTime.arrivalTime);
+
+			unsigned int trackedFrames = m_tracker->trackedFrames();
+			bool newPosition = trackedFrames != m_trackedFrames;
+			m_trackedFrames = trackedFrames;
+			if (newPosition) {
+				*timeValue = captureTime;
+			}
+			return newPosition;
+		}
 
-			if (m_useKudanPositionOnly) {
-				if (m_cameraType == 0) {
-					m_TrackerKudanRS = new TrackerKudanRS();
-					m_TrackerKudanRS->init();
-				}
-				else {
-					m_TrackerKudanGeneric = new TrackerKudanGeneric(m_cameraIndex);
-					m_TrackerKudanGeneric->init();
-				}
+	private:
+		// Once a second
+		void publishCameraClock(const OSVR_TimeValue& now) {
+			if (m_telemetry && now.seconds != m_lastClockPublish) {
+				CameraClockStats stats = m_cameraClock.getStats();
+				m_telemetry->publishCameraClock(stats.offset, stats.driftPpm, stats.residualMs, stats.sourceClock);
+				m_lastClockPublish = now.seconds;
 			}
-			else {
-				m_positionReader = PositionReaderFactory::getReader(m_ctx, config["position"]);
-				if (m_positionReader == NULL) {
-					std::cout << "[TrackerKudan-OSVR] Fusion Device: Position Reader not created" << std::endl;
+		}
+
+		Tracker* m_tracker;
+		MarkerCorrector* m_markerCorrector;
+		SessionRecorder* m_recorder;
+		IPositionReader* m_referenceReader;
+		unsigned int m_trackedFrames;
+
+		CameraClock m_cameraClock;
+		TelemetryTap* m_telemetry;	// optional, not owned
+		int64_t m_lastClockPublish;
+	};
+
+	/// KudanPosition tracked on the shared TrackingScheduler. The update callback submits the
+	/// latest orientation when the previous frame is done and returns its result, one tick later.
+	template <class Tracker>
+	class ScheduledKudanPosition {
+	public:
+		explicit ScheduledKudanPosition(FusionContext& context)
+			: m_scheduler(TrackingScheduler::getShared(context.config)), m_position(context) {
+			m_lane = m_scheduler->createLane(context.config["scheduler"].get("priority", "normal").asString().compare("high") == 0);
+			osvrVec3Zero(&m_jobPosition);
+			m_hasResult = false;
+		}
+		~ScheduledKudanPosition() { m_lane->waitIdle(); }
+
+		bool update(OSVR_PositionState* position, OSVR_OrientationState* orientation, OSVR_TimeValue* timeValue) {
+			bool newPosition = false;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_hasResult) {
+					*position = m_result;
+					*timeValue = m_resultTime;
+					m_hasResult = false;
+					newPosition = true;
 				}
 			}
 
-			m_dev->sendJsonDescriptor(com_samaust_trackerkudan_osvr_json);
-			m_dev->registerUpdateCallback(this);
+			m_position.updateReference();
+
+			// The job members are only touched by the job while the lane is busy
+			if (m_lane->idle()) {
+				m_jobOrientation = *orientation;
+				m_lane->submit([this] {
+					OSVR_TimeValue time;
+					if (m_position.track(&m_jobPosition, &m_jobOrientation, &time)) {
+						std::lock_guard<std::mutex> lock(m_mutex);
+						m_result = m_jobPosition;
+						m_resultTime = time;
+						m_hasResult = true;
+					}
+				});
+			}
+
+			return newPosition;
 		}
 
-		~TrackerKudanFusion() { delete m_TrackerKudanRS; delete m_TrackerKudanGeneric; }
+		// The tracker takes the new scale before its next frame, whichever thread runs it
+		void setParameters(const FusionParameters& parameters) {
+			m_position.setParameters(parameters);
+		}
 
-		OSVR_ReturnCode update() {
-			osvrClientUpdate(m_ctx);
+	private:
+		std::shared_ptr<TrackingScheduler> m_scheduler;
+		std::unique_ptr<TrackingScheduler::Lane> m_lane;
+		KudanPosition<Tracker> m_position;
 
-			OSVR_TimeValue timeValuePosition;
-			OSVR_TimeValue timeValueOrientation;
+		OSVR_PositionState m_jobPosition;
+		OSVR_OrientationState m_jobOrientation;
 
-			m_orientationReader->update(&m_state.rotation, &timeValueOrientation);
+		std::mutex m_mutex;
+		OSVR_PositionState m_result;
+		OSVR_TimeValue m_resultTime;
+		bool m_hasResult;
+	};
 
-			if (m_useKudanPositionOnly) {
-				if (m_cameraType == 0)
-					m_TrackerKudanRS->update(&m_state.translation, &m_state.rotation);
-				else
-					m_TrackerKudanGeneric->update(&m_state.translation, &m_state.rotation);
-			} 
+	/// Sends the pose, stamped as "timestamp" asks, and publishes it to the telemetry tap if any.
+	/// Both are runtime flags: a predictable branch per update costs less than doubling the pipeline
+	/// specialisations for each.
+	class PoseOutput {
+	public:
+		explicit PoseOutput(FusionContext& context)
+			: m_dev(context.device), m_tracker(context.tracker), m_timestamp(context.timestamp), m_telemetry(context.telemetry.get()) {}
+		void send(const OSVR_PoseState& state, const OSVR_TimeValue& timeValuePosition, const OSVR_TimeValue& timeValueOrientation) {
+			if (m_timestamp == TIMESTAMP_NONE) {
+				osvrDeviceTrackerSendPose(*m_dev, m_tracker, &state, 0);
+			}
 			else {
-				m_positionReader->update(&m_state.translation, &timeValuePosition);
+				osvrDeviceTrackerSendPoseTimestamped(*m_dev, m_tracker, &state, 0, m_timestamp == TIMESTAMP_POSITION ? &timeValuePosition : &timeValueOrientation);
+			}
+			if (m_telemetry) {
+				m_telemetry->publishPose(state.translation.data, state.rotation.data);
 			}
+		}
+	private:
+		osvr::pluginkit::DeviceToken* m_dev;
+		OSVR_TrackerDeviceInterface m_tracker;
+		TimestampSource m_timestamp;
+		TelemetryTap* m_telemetry;	// optional, not owned
+	};
+
+	// Creates the analysis device and its client context, the same for every pipeline
+	FusionContext createFusionContext(OSVR_PluginRegContext ctx, const FusionConfig& config) {
+		FusionContext context;
+		context.config = config.json;
+		context.parameters = config.parameters;
+		context.timestamp = config.timestamp;
+
+		OSVR_DeviceInitOptions opts = osvrDeviceCreateInitOptions(ctx);
+
+		osvrDeviceTrackerConfigure(opts, &context.tracker);
+
+		OSVR_DeviceToken token;
+		osvrAnalysisSyncInit(ctx, config.name.c_str(), opts, &token, &context.clientContext);
+
+		context.device = new osvr::pluginkit::DeviceToken(token);
+
+		if (config.useTelemetry) {
+			context.telemetry = std::make_shared<TelemetryTap>(config.name, config.json["telemetry"], getThreadPlacement(config.json, "telemetry"));
+		}
+
+		return context;
+	}
 
-			if (m_useOffset) {
-				Eigen::Quaterniond rotation = osvr::util::fromQuat(m_state.rotation);
-				Eigen::Map<Eigen::Vector3d> translation = osvr::util::vecMap(m_state.translation);
+	// The server update thread runs every plugin, at most one device places it
+	static std::atomic<bool> g_serverThreadPlaced(false);
 
-				translation += rotation._transformVector(osvr::util::vecMap(m_offset));
+	template <class Pipeline>
+	class TrackerKudanFusion {
+	public:
+		TrackerKudanFusion(OSVR_PluginRegContext ctx, const FusionConfig& config)
+			: m_context(createFusionContext(ctx, config)), m_pipeline(m_context) {
+			// Tracking runs inline in the update callback, on the server thread. That thread is not ours,
+			// it is only placed when asked for with "serverThread": true.
+			m_trackingPlacement = getThreadPlacement(config.json, "tracking");
+			m_placeServerThread = config.json["threads"]["tracking"].get("serverThread", false).asBool();
+
+			if (!config.reloadFile.empty()) {
+				m_reloader.reset(new ParameterReloader(config, getThreadPlacement(config.json, "reload")));
 			}
 
-			if (m_useTimestamp) {
-				OSVR_TimeValue timeValue = m_usePositionTimestamp ? timeValuePosition : timeValueOrientation;
-				osvrDeviceTrackerSendPoseTimestamped(*m_dev, m_tracker, &m_state, 0, &timeValue);
+			m_context.device->sendJsonDescriptor(com_samaust_trackerkudan_osvr_json);
+			m_context.device->registerUpdateCallback(this);
+		}
+
+		OSVR_ReturnCode update() {
+			if (m_placeServerThread) {
+				if (!g_serverThreadPlaced.exchange(true)) {
+					std::cout << "[TrackerKudan-OSVR] Placing the server update thread, shared by all the plugins, as " << m_trackingPlacement.name << std::endl;
+					applyThreadPlacement(m_trackingPlacement);
+				}
+				else {
+					std::cout << "[TrackerKudan-OSVR] The server update thread is already placed by another device, \"tracking\" ignored" << std::endl;
+				}
+				m_placeServerThread = false;
 			}
-			else {
-				osvrDeviceTrackerSendPose(*m_dev, m_tracker, &m_state, 0);
+
+			// Reloaded parameters apply between two frames, a pose never mixes old and new ones
+			FusionParameters parameters;
+			if (m_reloader && m_reloader->takePending(&parameters)) {
+				m_pipeline.setParameters(parameters);
 			}
 
+			osvrClientUpdate(m_context.clientContext);
+			m_pipeline.update();
+
 			return OSVR_RETURN_SUCCESS;
 		}
 
 	private:
-		IPositionReader* m_positionReader;
-		IOrientationReader* m_orientationReader;
-
-		OSVR_ClientContext m_ctx;
-		OSVR_ClientInterface m_position;
-		OSVR_ClientInterface m_orientation;
+		FusionContext m_context;
+		Pipeline m_pipeline;
+		std::unique_ptr<ParameterReloader> m_reloader;
 
-		osvr::pluginkit::DeviceToken* m_dev;
-		OSVR_TrackerDeviceInterface m_tracker;
-		OSVR_PoseState m_state;
-		
-		TrackerKudanRS *m_TrackerKudanRS;
-		TrackerKudanGeneric *m_TrackerKudanGeneric;
-
-		bool m_useOffset;
-		OSVR_Vec3 m_offset;
-
-		bool m_useTimestamp;
-		bool m_usePositionTimestamp;
-		bool m_useKudanPositionOnly;
-		int m_cameraType;
-		int m_cameraIndex;
+		ThreadPlacement m_trackingPlacement;
+		bool m_placeServerThread;	// until the first update
 	};
 
+	/// Resolves the configuration into one FusionPipeline specialisation, one policy at a time,
+	/// so that the update callback has no per tick branches on it.
 	class TrackerKudanFusionConstructor {
 	public:
 		TrackerKudanFusionConstructor() {}
@@ -149,8 +353,68 @@ namespace com_samaust_trackerkudan_osvr {
 				return OSVR_RETURN_FAILURE;
 			}
 
+			FusionConfig config;
+			std::string error;
+			if (!FusionConfig::parse(root, &config, &error)) {
+				std::cerr << "[TrackerKudan-OSVR] Invalid parameters: " << error << std::endl;
+				return OSVR_RETURN_FAILURE;
+			}
+
+			return createWithOrientation(ctx, config);
+		}
+
+	private:
+		OSVR_ReturnCode createWithOrientation(OSVR_PluginRegContext ctx, const FusionConfig& config) {
+			if (config.orientation == ORIENTATION_COMBINED) {
+				return createWithPosition<ReaderOrientation<CombinedOrientationReader> >(ctx, config);
+			}
+			return createWithPosition<ReaderOrientation<SingleOrientationReader> >(ctx, config);
+		}
+
+		template <class Orientation>
+		OSVR_ReturnCode createWithPosition(OSVR_PluginRegContext ctx, const FusionConfig& config) {
+			switch (config.position) {
+			case POSITION_SINGLE:
+				return createWithFilter<Orientation, ReaderPosition<SinglePositionReader> >(ctx, config);
+			case POSITION_COMBINED:
+				return createWithFilter<Orientation, ReaderPosition<CombinedPositionReader> >(ctx, config);
+			case POSITION_KUDAN:
+				break;
+			}
+
+			if (config.cameraType == 0) {
+				if (config.useScheduler) {
+					return createWithFilter<Orientation, ScheduledKudanPosition<TrackerKudanRS> >(ctx, config);
+				}
+				return createWithFilter<Orientation, KudanPosition<TrackerKudanRS> >(ctx, config);
+			}
+			if (config.useScheduler) {
+				return createWithFilter<Orientation, ScheduledKudanPosition<TrackerKudanGeneric> >(ctx, config);
+			}
+			return createWithFilter<Orientation, KudanPosition<TrackerKudanGeneric> >(ctx, config);
+		}
+
+		template <class Orientation, class Position>
+		OSVR_ReturnCode createWithFilter(OSVR_PluginRegContext ctx, const FusionConfig& config) {
+			// The filter passes positions through unchanged with these, no need to run it unless a reload may change them
+			if (config.reloadFile.empty() && config.parameters.filterAlpha == 1.0 && config.parameters.predictionHorizon == 0.0) {
+				return createWithOffset<Orientation, Position, PassThroughFilter>(ctx, config);
+			}
+			return createWithOffset<Orientation, Position, SmoothingFilter>(ctx, config);
+		}
+
+		template <class Orientation, class Position, class Filter>
+		OSVR_ReturnCode createWithOffset(OSVR_PluginRegContext ctx, const FusionConfig& config) {
+			if (config.parameters.useOffset || !config.reloadFile.empty()) {
+				return create<FusionPipeline<Orientation, Position, Filter, RotationCenterOffset, PoseOutput> >(ctx, config);
+			}
+			return create<FusionPipeline<Orientation, Position, Filter, NoOffset, PoseOutput> >(ctx, config);
+		}
+
+		template <class Pipeline>
+		OSVR_ReturnCode create(OSVR_PluginRegContext ctx, const FusionConfig& config) {
 			osvr::pluginkit::registerObjectForDeletion(
-				ctx, new TrackerKudanFusion(ctx, root));
+				ctx, new TrackerKudanFusion<Pipeline>(ctx, config));
 
 			return OSVR_RETURN_SUCCESS;
 		}